@@ -1,9 +1,11 @@
-#include <map>
 #include <mysql/mysql.h>
 #include <fstream>
-#include <mutex>
 #include "http_connection.h"
+#include "../pool/async_query.h"
+#include "../store/credential_loader.h"
+#include "../store/credential_cache.h"
 #include "../log/log.h"
+#include "../log/access_log.h"
 
 //#define connfdET //边缘触发非阻塞
 #define connfdLT //水平触发阻塞
@@ -22,14 +24,29 @@ const char *error_404_form = "The requested file was not found on this server.\n
 const char *error_500_title = "Internal Error";
 const char *error_500_form = "There was an unusual problem serving the request file.\n";
 
+// 任务队列已满时返回的503响应报文，预先生成以免在主线程中格式化
+const char busy_503_response[] = "HTTP/1.1 503 Service Unavailable\r\n"
+	"Retry-After:1\r\nContent-Length:44\r\nConnection:close\r\n\r\n"
+	"The server is busy, please try again later.\n";
+
 // 请求资源所在的根目录
 const char *doc_root = "/home/bd7xzz/Desktop/WebServer/root";
 
-// 该map用于记录数据库user数据表中已经存在的用户信息（用户名和密码）
-std::map<std::string, std::string> users;
+// 记录数据库user数据表中已经存在的用户信息（用户名和密码），登录校验无锁，注册只锁住所在的分片
+// 使用快照文件时，只记录快照之后新增的用户，快照中的用户由user_loader在映射的文件中查找
+credential_store users;
+
+// users中用户名的布隆过滤器，判定用户名一定不存在时，注册和登录无需再查找users或数据库
+bloom_filter user_filter;
+
+// 用户数据的加载器，负责映射快照文件并从数据库增量同步用户
+credential_loader user_loader(users, user_filter);
+
+// 按需加载模式下的用户凭据缓存，为nullptr表示启动时加载所有用户（使用users、user_filter和user_loader）
+std::unique_ptr<credential_cache> user_cache;
 
-// 互斥锁
-std::mutex mtx;
+// 注册用户的后写队列，由后台线程批量写入数据库
+registration_writer user_writer;
 
 // 将文件描述符设置为非阻塞式
 int set_nonblocking(int fd) {
@@ -95,6 +112,7 @@ void remove_fd(int epollfd, int fd) {
 // 初始化类的静态成员变量（epoll对象的文件描述符、连接的客户端的数量）
 int http_connection::_epollfd = -1;
 int http_connection::_user_count = 0;
+io_scheduler *http_connection::_scheduler = nullptr;
 
 // 初始化连接，设置客户端socket文件描述符和socket地址等信息?
 void http_connection::init(int sockfd, const sockaddr_in &addr) {
@@ -107,9 +125,6 @@ void http_connection::init(int sockfd, const sockaddr_in &addr) {
 
 // 初始化新接受的连接?
 void http_connection::init() {
-	// 初始化数据库连接
-	_mysql = nullptr;
-
 	// 初始化读缓冲区和索引位置
     bzero(_read_buf, READ_BUFFER_SIZE);
     _read_idx = 0; _checked_idx = 0; _start_line = 0;
@@ -124,9 +139,11 @@ void http_connection::init() {
 	// 初始化请求行中的字段（请求方法--默认为GET、url、http版本号）
     _request_method = REQUEST_METHOD::GET;
     _cgi = false; _url = nullptr; _version = nullptr;
+	_request_target[0] = '\0';
 
 	// 初始化请求头中的字段（服务器域名、请求数据长度、连接管理--默认为短连接：close）
     _host = nullptr; _content_length = 0; _linger = false;
+	_referer = nullptr; _user_agent = nullptr;
 
 	// 初始化所请求资源的文件路径
     bzero(_real_file, FILE_NAME_SIZE);
@@ -134,6 +151,13 @@ void http_connection::init() {
 
 	// 初始化字节数（已发送/待发生）
     _bytes_sent = 0; _bytes_left = 0;
+
+	// 初始化运行至完成模式的状态
+	_inline = false; _deferred = false;
+
+	// 初始化访问日志记录的状态码和各阶段耗时
+	_status = 0;
+	_queue_time = _parse_time = _exec_time = std::chrono::nanoseconds::zero();
 }
 
 // 关闭连接，并递减对应的连接客户端计数器
@@ -145,31 +169,125 @@ void http_connection::close_connection(bool real_close) {
     }
 }
 
-// 将数据库中已有的所有用户数据检索出来并存入users中，用于登录校验
-void http_connection::init_mysql_result(connection_pool *conn_pool) {
-    // 从连接池中取一个连接
-    MYSQL *mysql = nullptr;
-    sql_connection mysql_conn(&mysql, conn_pool);
+// 关闭socket的读写，但不关闭文件描述符，连接对象及其定时器都由主线程管理
+// 重新注册读事件后，主线程会检测到EPOLLHUP，并通过定时器回调函数统一回收连接
+void http_connection::shutdown_connection() {
+	shutdown(_sockfd, SHUT_RDWR);
+	reset_fd(_epollfd, _sockfd, EPOLLIN);
+}
+
+// 加载用户数据，用于登录校验：映射快照文件，并从数据库增量检索快照之后新增的用户存入users中
+// 未指定快照文件时，从数据库检索所有用户
+void http_connection::init_mysql_result(connection_pool *conn_pool, const std::string &snapshot_path) {
+	user_loader.load(conn_pool, snapshot_path);
+}
+
+// 按需加载模式下，通过预处理语句从数据库检索单个用户的凭据
+static CREDENTIAL_STATUS fetch_user(connection_pool *conn_pool, std::string_view name, std::string &password) {
+	MYSQL *mysql = nullptr;
+	sql_connection mysql_conn(&mysql, conn_pool);
+	MYSQL_STMT *stmt = mysql_conn.statement(SQL_STATEMENT::SELECT_USER);
+	if (!stmt) {
+		LOG_ERROR("mysql prepare error: {}", mysql ? mysql_error(mysql) : "no connection");
+		return CREDENTIAL_STATUS::ERROR;
+	}
+	unsigned long name_length = name.size(), password_length = 0;
+	MYSQL_BIND param, result;
+	memset(&param, 0, sizeof(param));
+	param.buffer_type = MYSQL_TYPE_STRING;
+	param.buffer = const_cast<char*>(name.data());
+	param.length = &name_length;
+	// passwd列为char(50)，缓冲区足以容纳
+	char buffer[256];
+	memset(&result, 0, sizeof(result));
+	result.buffer_type = MYSQL_TYPE_STRING;
+	result.buffer = buffer;
+	result.buffer_length = sizeof(buffer);
+	result.length = &password_length;
+	if (mysql_stmt_bind_param(stmt, &param) || mysql_stmt_execute(stmt) || mysql_stmt_bind_result(stmt, &result)) {
+		LOG_ERROR("mysql select error: {}", mysql_stmt_error(stmt));
+		return CREDENTIAL_STATUS::ERROR;
+	}
+	int ret = mysql_stmt_fetch(stmt);
+	// 释放结果集，使该语句可再次执行
+	mysql_stmt_free_result(stmt);
+	if (ret == MYSQL_NO_DATA) return CREDENTIAL_STATUS::NOT_FOUND;
+	if (ret != 0 || password_length > sizeof(buffer)) {
+		LOG_ERROR("mysql fetch error: {}", mysql_stmt_error(stmt));
+		return CREDENTIAL_STATUS::ERROR;
+	}
+	password.assign(buffer, password_length);
+	return CREDENTIAL_STATUS::FOUND;
+}
 
-    // 在user数据表中检索所有用户的数据
-    if (mysql_query(mysql, "SELECT username, passwd FROM user"))
-		LOG_ERROR("mysql select error: ", mysql_error(mysql));
+// 按需加载模式下检索用户凭据所使用的连接池
+static connection_pool *cache_pool = nullptr;
 
-    // 获取检索的结果集，并通过循环每次从结果集中取出下一条用户数据存入map中
-    MYSQL_RES *result = mysql_store_result(mysql);
-    while (MYSQL_ROW row = mysql_fetch_row(result)) users[row[0]] = row[1];
+// 按需加载模式：启动时不检索用户，登录和注册时才从数据库检索，并缓存最多capacity个用户
+void http_connection::init_mysql_cache(connection_pool *conn_pool, std::size_t capacity) {
+	cache_pool = conn_pool;
+	user_cache.reset(new credential_cache([conn_pool](std::string_view name, std::string &password) {
+		return fetch_user(conn_pool, name, password);
+	}, capacity));
+}
+
+// 启动注册用户的后台写入线程，ack为注册的持久化确认方式
+// 按需加载模式下缓存只保存部分用户，无法原子地占用用户名，并发的同名注册只能由数据库的唯一约束裁决，
+// 因此强制使用COMMITTED方式，否则两个注册可能都被确认，后写入缓存的密码覆盖前一个
+void http_connection::init_mysql_writer(connection_pool *conn_pool, REGISTER_ACK ack) {
+	if (user_cache && ack == REGISTER_ACK::QUEUED) {
+		LOG_WARN("queued registration is not supported with lazy user loading, using committed");
+		ack = REGISTER_ACK::COMMITTED;
+	}
+	user_writer.init(conn_pool, ack);
+}
+
+// 停止后台同步用户数据，并写入队列中剩余的注册用户，需在销毁连接池之前调用
+void http_connection::close_mysql_result() {
+	user_loader.stop();
+	user_writer.stop();
 }
 
 // 由工作线程执行的任务处理函数，完成对报文的解析和响应
 void http_connection::process() {
 	// 解析请求报文，若返回结果为HTTP_CODE::NO_REQUEST
 	// 表示尚未解析到完整请求，则需继续接收请求数据以供解析
-    HTTP_CODE read_ret = process_read();
+	// 若请求已在主线程中解析完毕（运行至完成模式下被推迟），则直接执行请求
+	// 从请求数据读取完毕（或被主线程推迟）到开始处理的时间即为在任务队列中等待的耗时
+	// 登录/注册请求在exec_request中被推迟（再次设置_deferred），由协程执行校验并发送响应
+	_queue_time += std::chrono::steady_clock::now() - _time_ready;
+	bool deferred = std::exchange(_deferred, false);
+    HTTP_CODE read_ret = deferred ? timed_exec_request() : timed_process_read();
+	if (_deferred) { _deferred = false; co_spawn(process_cgi()); return; }
     if (read_ret == HTTP_CODE::NO_REQUEST) { reset_fd(_epollfd, _sockfd, EPOLLIN); return; }
 	// 若解析到了完整的请求，则向写缓冲区写入数据完成对请求报文的响应?
-	if (!process_write(read_ret)) close_connection();
-	// 注册EPOLLOUT事件，使主线程可检测写事件，以通过write将响应报文发送给客户端（浏览器）
-    reset_fd(_epollfd, _sockfd, EPOLLOUT);
+	// 工作线程直接发送响应报文，由于套接字发送缓冲区通常是可写的，因此无需先注册EPOLLOUT事件
+	// 再等待主线程发送，只有发送缓冲区已满（EAGAIN）时，write才会注册EPOLLOUT事件交由主线程继续发送
+	// 连接由主线程管理，因此发送失败或短连接发送完毕时，只关闭socket的读写，由主线程回收连接
+	if (!process_write(read_ret) || !write()) shutdown_connection();
+}
+
+// 运行至完成模式：由主线程直接解析并响应无需阻塞操作的请求（如小的静态资源文件）
+// 省去了交由工作线程处理再注册EPOLLOUT事件等待主线程发送的两次线程切换和一次epoll_ctl
+// 若请求需要访问数据库或发送大文件，则exec_request会推迟执行并设置_deferred
+// 此时返回false，由调用者将请求交由工作线程，工作线程无需重新解析请求
+bool http_connection::process_inline() {
+	_inline = true;
+	HTTP_CODE read_ret = timed_process_read();
+	_inline = false;
+	if (_deferred) { _time_ready = std::chrono::steady_clock::now(); return false; }
+	if (read_ret == HTTP_CODE::NO_REQUEST) { reset_fd(_epollfd, _sockfd, EPOLLIN); return true; }
+	// 生成响应报文后直接发送，发送失败或短连接发送完毕，则由主线程在下一轮事件循环中回收连接
+	if (!process_write(read_ret) || !write()) shutdown_connection();
+	return true;
+}
+
+// 工作线程读模式：主线程只检测读就绪事件，由工作线程读取客户数据并处理请求
+// 连接注册了EPOLLONESHOT事件，在工作线程重新注册事件之前，主线程不会再次处理该连接
+// 读取失败（对端关闭或读缓冲区已满）时，同样只关闭socket的读写，由主线程回收连接
+void http_connection::read_and_process() {
+	if (!read_once()) { shutdown_connection(); return; }
+	process();
 }
 
 // 当有读事件发生，则从套接字中读取客户数据，有LT和ET两种模式
@@ -184,6 +302,7 @@ bool http_connection::read_once() {
     bytes_read = recv(_sockfd, _read_buf + _read_idx, READ_BUFFER_SIZE - _read_idx, 0);
     if (bytes_read <= 0) return false;
     _read_idx += bytes_read;
+	_time_ready = std::chrono::steady_clock::now();
     return true;
 #endif
 
@@ -197,14 +316,17 @@ bool http_connection::read_once() {
         else if (bytes_read == 0) return false;
         _read_idx += bytes_read;
     }
+	_time_ready = std::chrono::steady_clock::now();
     return true;
 #endif
 }
 
-// 当主线程检测到写事件，会调用该函数将响应报文发送给客户端浏览器
+// 生成响应报文后由工作线程（或运行至完成模式下的主线程）直接调用该函数发送响应报文
+// 若发送缓冲区已满，则注册EPOLLOUT事件，主线程检测到写事件后再调用该函数继续发送
 bool http_connection::write() {
 	// 若待发送的数据长度为0，则表示响应报文为空，一般不会出现该情况
-    if (_bytes_left == 0) { reset_fd(_epollfd, _sockfd, EPOLLIN); init(); return true; }
+	// 须先重置连接再注册读事件，因为write可能由工作线程调用，注册后主线程随时可能处理该连接
+    if (_bytes_left == 0) { init(); reset_fd(_epollfd, _sockfd, EPOLLIN); return true; }
 
     int tmp = 0;
     while (true) {
@@ -216,6 +338,7 @@ bool http_connection::write() {
             if (errno == EAGAIN) { reset_fd(_epollfd, _sockfd, EPOLLOUT); return true; }
 			// 否则表示发送失败，且不是缓冲区问题，因此解除文件到内存的映射
 			if (_file_address) { munmap(_file_address, _file_stat.st_size); _file_address = nullptr; }
+			log_access();
             return false;
         }
 
@@ -234,19 +357,25 @@ bool http_connection::write() {
             _iv[0].iov_len = _iv[0].iov_len - _bytes_sent;
         }
 
-		// 数据已经全部发送完毕
+		// 数据已经全部发送完毕，须在重置连接之前写入访问日志
         if (_bytes_left <= 0) {
+			log_access();
 			// 解除文件到内存的映射，并释放相关资源
 			if (_file_address) { munmap(_file_address, _file_stat.st_size); _file_address = nullptr; }
-            reset_fd(_epollfd, _sockfd, EPOLLIN);
-			// 若为长连接，则重置http连接对象的信息
-            if (_linger) { init(); return true; }
+			// 若为长连接，则重置http连接对象的信息，并重新注册读事件
+            if (_linger) { init(); reset_fd(_epollfd, _sockfd, EPOLLIN); return true; }
 			// 否则为短连接，则需要断开连接
             else return false;
         }
     }
 }
 
+// 任务队列已满时，直接向客户端发送预生成的503响应报文，不经过工作线程
+// 响应报文很短，通常可一次性写入套接字发送缓冲区，发送失败也无需重试，随后由主线程关闭连接
+void http_connection::reject_busy() {
+	send(_sockfd, busy_503_response, sizeof(busy_503_response) - 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+}
+
 // 根据主从状态机状态，通过循环来不停地解析请求报文中的数据
 http_connection::HTTP_CODE http_connection::process_read() {
 	// 初始化从状态机（成功解析完一行）和报文解析结果（请求尚未完整）
@@ -280,7 +409,7 @@ http_connection::HTTP_CODE http_connection::process_read() {
 					ret = parse_headers(text);
 					if (ret == HTTP_CODE::BAD_REQUEST) return HTTP_CODE::BAD_REQUEST;
 					// 由于GET请求无请求数据，所以解析完请求头后可直接执行响应函数
-					else if (ret == HTTP_CODE::GET_REQUEST) return exec_request();
+					else if (ret == HTTP_CODE::GET_REQUEST) return timed_exec_request();
 					break;
 				}
 			// 表示正在解析请求数据内容（请求方法为POST时）
@@ -288,7 +417,7 @@ http_connection::HTTP_CODE http_connection::process_read() {
 				{
 					ret = parse_content(text);
 					// 若完整解析了POST的请求数据，则表示报文已全部解析完毕，可执行响应函数
-					if (ret == HTTP_CODE::GET_REQUEST) return exec_request();
+					if (ret == HTTP_CODE::GET_REQUEST) return timed_exec_request();
 					// 将从状态设置为LINE_STATUS::LINE_OPEN，以免再次进入循环
 					line_status = LINE_STATUS::LINE_OPEN;
 					break;
@@ -365,6 +494,8 @@ http_connection::HTTP_CODE http_connection::parse_request_line(char *text) {
     if (strncasecmp(_url, "https://", 8) == 0) { _url += 8; _url = strchr(_url, '/'); }
 	// url中无上述两种符号，直接是单独的/或//后接访问资源，则请求报文有语法错误
     if (!_url || _url[0] != '/') return HTTP_CODE::BAD_REQUEST;
+	// 在改写_url之前保存原始的请求目标，供访问日志使用
+	snprintf(_request_target, FILE_NAME_SIZE, "%s", _url);
 
     // 当url为/时，默认显示校验界面
     if (strlen(_url) == 1) strcat(_url, "judge.html");
@@ -402,10 +533,18 @@ http_connection::HTTP_CODE http_connection::parse_headers(char *text) {
     else if (strncasecmp(text, "Host:", 5) == 0) {
         text += 5; text += strspn(text, " \t");
         _host = text;
+    }
+	// 解析请求头中的来源页面和客户端标识字段，仅用于访问日志
+    else if (strncasecmp(text, "Referer:", 8) == 0) {
+        text += 8; text += strspn(text, " \t");
+        _referer = text;
+    }
+    else if (strncasecmp(text, "User-Agent:", 11) == 0) {
+        text += 11; text += strspn(text, " \t");
+        _user_agent = text;
     }
     else {
-        LOG_INFO("oop! unknow header: ", text);
-        log::get_instance()->flush();
+        LOG_INFO("oop! unknow header: {}", text);
     }
     return HTTP_CODE::NO_REQUEST;
 }
@@ -432,52 +571,9 @@ http_connection::HTTP_CODE http_connection::exec_request() {
 	// 找到url中/的位置
     const char *p = strrchr(_url, '/');
 
-    // 若_cgi为true，则表示是POST请求，需要进行登录校验或注册校验
-    if (_cgi == true && (*(p + 1) == '2' || *(p + 1) == '3')) {
-        // 根据标志判断是登录校验还是注册校验
-        char flag = _url[1];
-        char *url_real = (char*)malloc(sizeof(char) * 200);
-        strcpy(url_real, "/");
-        strcat(url_real, _url + 2);
-        strncpy(_real_file + len, url_real, FILE_NAME_SIZE - len - 1);
-        free(url_real);
-
-        // 将用户名和密码提取出来，POST请求通过&字符来连接字段
-        char name[100], password[100];
-        int i = 5, j = 0;
-        while (_user_info[i] != '&') { name[i-5] = _user_info[i]; ++i; }
-        name[i - 5] = '\0'; i += 10;
-        while (_user_info[i] != '\0') password[j++] = _user_info[i++];
-        password[j] = '\0';
-
-        // 同步线程注册校验
-        if (*(p + 1) == '3') {
-            // 若为注册，先检测数据库中用户名是否已存在，若尚为存在，则新增数据
-            char *sql_insert = (char*)malloc(sizeof(char) * 200);
-            strcpy(sql_insert, "INSERT INTO user(username, passwd) VALUES(");
-            strcat(sql_insert, "'");
-            strcat(sql_insert, name);
-            strcat(sql_insert, "', '");
-            strcat(sql_insert, password);
-            strcat(sql_insert, "')");
-
-            if (users.find(name) == users.end()) {
-				std::unique_lock<std::mutex> lock(mtx);
-                int res = mysql_query(_mysql, sql_insert);
-                users.insert(std::pair<std::string, std::string>(name, password));
-                lock.unlock();
-
-                if (!res) strcpy(_url, "/log.html");
-                else strcpy(_url, "/registerError.html");
-            }
-            else strcpy(_url, "/registerError.html");
-        }
-		// 登录校验，若客户端输入的用户名和密码在全局的users中可以查到，则登录成功
-        else if (*(p + 1) == '2') {
-            if (users.find(name) != users.end() && users[name] == password) strcpy(_url, "/welcome.html");
-            else strcpy(_url, "/logError.html");
-        }
-    }
+	// 登录/注册校验需要访问数据库，推迟执行：主线程中交由工作线程，工作线程中交由process_cgi在协程中执行
+	// 校验完成后_url被改写为结果页面，再次执行请求时不会进入该分支
+	if (_cgi == true && (*(p + 1) == '2' || *(p + 1) == '3')) { _deferred = true; return HTTP_CODE::NO_REQUEST; }
 
 	// 根据不同的请求资源类型，跳转到不同的资源页面
 	char *tmp_url = (char*)malloc(sizeof(char) * 200);
@@ -506,6 +602,8 @@ http_connection::HTTP_CODE http_connection::exec_request() {
     if (!(_file_stat.st_mode & S_IROTH)) return HTTP_CODE::FORBIDDEN_REQUEST;
 	// 判断文件类型是否为目录，若为目录，则表明请求报文有错误
     if (S_ISDIR(_file_stat.st_mode)) return HTTP_CODE::BAD_REQUEST;
+	// 大文件的发送耗时较长，不能在主线程中执行
+	if (_inline && _file_stat.st_size > INLINE_FILE_SIZE) { _deferred = true; return HTTP_CODE::NO_REQUEST; }
 	// 以只读模式打开文件
     int fd = open(_real_file, O_RDONLY);
 	// 将文件映射到内存，提高读取速度，并返回文件映射到的内存地址
@@ -515,8 +613,162 @@ http_connection::HTTP_CODE http_connection::exec_request() {
     return HTTP_CODE::FILE_REQUEST;
 }
 
+#ifdef _MYSQL_NONBLOCKING
+// 按需加载模式下，以非阻塞的SQL语句检索单个用户的凭据，等待数据库响应期间挂起协程
+// 非阻塞接口不支持预处理语句，因此转义用户名后拼接SQL语句
+static task<CREDENTIAL_STATUS> async_fetch_user(std::string name, std::string &password) {
+	MYSQL *mysql = nullptr;
+	sql_connection mysql_conn(&mysql, cache_pool);
+	if (!mysql) {
+		LOG_ERROR("mysql select error: {}", "no connection");
+		co_return CREDENTIAL_STATUS::ERROR;
+	}
+	std::string escaped(name.size() * 2 + 1, '\0');
+	escaped.resize(mysql_real_escape_string(mysql, escaped.data(), name.data(), name.size()));
+	if (!co_await async_query(http_connection::_scheduler, mysql, "SELECT passwd FROM user WHERE username = '" + escaped + "' LIMIT 1")) {
+		LOG_ERROR("mysql select error: {}", mysql_error(mysql));
+		co_return CREDENTIAL_STATUS::ERROR;
+	}
+	MYSQL_RES *result = co_await async_store_result(http_connection::_scheduler, mysql);
+	if (!result) {
+		LOG_ERROR("mysql store result error: {}", mysql_error(mysql));
+		co_return CREDENTIAL_STATUS::ERROR;
+	}
+	// 结果集已全部取回，读取时不会阻塞
+	MYSQL_ROW row = mysql_fetch_row(result);
+	if (row) password.assign(row[0], mysql_fetch_lengths(result)[0]);
+	mysql_free_result(result);
+	co_return row ? CREDENTIAL_STATUS::FOUND : CREDENTIAL_STATUS::NOT_FOUND;
+}
+#endif
+
+// 按需加载模式下查找用户凭据：命中缓存时直接返回，未命中时以非阻塞的SQL语句检索，检索期间同一用户名的查找合并到该检索
+// 客户端库不支持非阻塞接口（或没有调度器）时，退回到阻塞的get，由当前的工作线程（数据库车道）检索
+static task<CREDENTIAL_STATUS> lookup_user(std::string name, std::string &password) {
+#ifdef _MYSQL_NONBLOCKING
+	if (http_connection::_scheduler) {
+		CREDENTIAL_STATUS status;
+		if (user_cache->lookup(name, status, password)) co_return status;
+		bool owner = user_cache->begin_fetch(name);
+		status = co_await async_fetch_user(name, password);
+		if (owner) user_cache->end_fetch(name, status, password);
+		co_return status;
+	}
+#endif
+	co_return user_cache->get(name, password);
+}
+
+// 等待注册的用户提交的awaiter：将用户写入后写队列后挂起协程，后台线程在批次提交后通过调度器恢复协程
+// 等待组提交期间不占用工作线程，后写队列未初始化时不挂起，直接返回注册失败
+// 回调函数可能先于await_suspend返回而被调用，因此写入队列后不能再访问awaiter
+struct commit_awaiter {
+	std::string_view name;
+	std::string_view password;
+	bool ok = false;
+	bool await_ready() const noexcept { return false; }
+	bool await_suspend(std::coroutine_handle<> handle) {
+		return user_writer.submit(name, password, [this, handle](bool committed) {
+			ok = committed;
+			http_connection::_scheduler->post(handle);
+		});
+	}
+	bool await_resume() const noexcept { return ok; }
+};
+
+// COMMITTED方式下等待注册的用户写入数据库，QUEUED方式（或没有调度器）时直接调用submit
+static task<bool> commit_user(std::string name, std::string password) {
+	if (user_writer.ack() == REGISTER_ACK::QUEUED || !http_connection::_scheduler) co_return user_writer.submit(name, password);
+	co_return co_await commit_awaiter{name, password};
+}
+
+// 注册校验：先检测用户名是否已存在，若尚不存在，则写入后写队列，由后台线程批量写入数据库
+static task<bool> register_user(std::string name, std::string password) {
+	// 按需加载模式下，用户名不存在（包括负缓存）时才写入数据库，提交成功后写入缓存
+	// 该模式总是使用COMMITTED方式，并发注册同一用户名时依靠数据表中用户名的唯一约束，只有一个请求写入成功
+	if (user_cache) {
+		std::string stored;
+		if (co_await lookup_user(name, stored) != CREDENTIAL_STATUS::NOT_FOUND || !co_await commit_user(name, password)) co_return false;
+		user_cache->put(name, password);
+		co_return true;
+	}
+	// 布隆过滤器判定一定不存在的用户名跳过查找，只有可能重复的用户名才需要在users中确认
+	// 用户名需先加入布隆过滤器再写入users，确保在users中可见的用户名不会被判定为一定不存在
+	// users和布隆过滤器均不支持删除，因此写入失败的用户名不能先加入其中：
+	// 1. QUEUED方式下先通过insert原子地占用用户名，并发注册同一用户名时只有一个请求会写入队列，
+	//    此时submit只会在后写队列未初始化时失败，而写入数据库的失败本就不会反馈给客户端
+	// 2. COMMITTED方式下先写入数据库，由用户名的唯一约束裁决并发的同名注册，提交成功后才加入users
+	if (user_loader.contains(name) || (user_filter.may_contain(name) && users.contains(name))) co_return false;
+	if (user_writer.ack() == REGISTER_ACK::QUEUED) {
+		user_filter.add(name);
+		co_return users.insert(name, password) && user_writer.submit(name, password);
+	}
+	if (!co_await commit_user(name, password)) co_return false;
+	user_filter.add(name);
+	co_return users.insert(name, password);
+}
+
+// 登录校验，若客户端输入的用户名和密码在全局的users（或缓存）中可以查到，则登录成功
+static task<bool> verify_user(std::string name, std::string password) {
+	if (!user_cache) co_return user_loader.verify(name, password) || (user_filter.may_contain(name) && users.verify(name, password));
+	std::string stored;
+	co_return co_await lookup_user(name, stored) == CREDENTIAL_STATUS::FOUND && stored == password;
+}
+
+// 在协程中执行登录/注册校验，由工作线程启动，执行到第一个挂起点为止
+// 等待数据库期间协程挂起，工作线程返回线程池，数据库响应（或批次提交）后由调度器交给线程池的数据库车道恢复执行
+// 校验完成后将_url改写为结果页面，再执行请求并发送响应，连接注册了EPOLLONESHOT事件，期间不会被其他线程处理
+task<void> http_connection::process_cgi() {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	// 根据标志判断是登录校验还是注册校验
+	char flag = strrchr(_url, '/')[1];
+
+	// 将用户名和密码提取出来，POST请求通过&字符来连接字段
+	char name[100], password[100];
+	int i = 5, j = 0;
+	while (_user_info[i] != '&') { name[i-5] = _user_info[i]; ++i; }
+	name[i - 5] = '\0'; i += 10;
+	while (_user_info[i] != '\0') password[j++] = _user_info[i++];
+	password[j] = '\0';
+
+	if (flag == '3') strcpy(_url, co_await register_user(name, password) ? "/log.html" : "/registerError.html");
+	else strcpy(_url, co_await verify_user(name, password) ? "/welcome.html" : "/logError.html");
+	_exec_time += std::chrono::steady_clock::now() - start;
+
+	HTTP_CODE ret = timed_exec_request();
+	if (!process_write(ret) || !write()) shutdown_connection();
+}
+
+// 解析请求报文，解析完整后会直接执行请求，因此解析耗时需扣除其中执行请求的耗时
+http_connection::HTTP_CODE http_connection::timed_process_read() {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::chrono::nanoseconds exec_time = _exec_time;
+	HTTP_CODE ret = process_read();
+	_parse_time += (std::chrono::steady_clock::now() - start) - (_exec_time - exec_time);
+	return ret;
+}
+
+// 执行请求，并累计执行耗时（运行至完成模式下被推迟的请求会执行两次，第一次只判断是否需要推迟）
+http_connection::HTTP_CODE http_connection::timed_exec_request() {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	HTTP_CODE ret = exec_request();
+	_exec_time += std::chrono::steady_clock::now() - start;
+	return ret;
+}
+
+// 响应发送完毕（或发送失败）时调用，发送耗时从开始生成响应报文算起，包括等待套接字可写的时间
+// 填写访问记录之前先判断是否采样，未采样的请求几乎没有额外开销
+void http_connection::log_access() {
+	access_log *logger = access_log::get_instance();
+	if (!logger->sampled(_status)) return;
+	access_record record{_address, _request_method == REQUEST_METHOD::POST ? "POST" : "GET", _request_target[0] ? _request_target : "-",
+		_referer, _user_agent, _status, _bytes_sent, _linger, _queue_time, _parse_time, _exec_time,
+		std::chrono::steady_clock::now() - _time_responded};
+	logger->submit(record);
+}
+
 // 根据http状态码向写缓冲区中写入响应报文
 bool http_connection::process_write(HTTP_CODE ret) {
+	_time_responded = std::chrono::steady_clock::now();
     switch (ret) {
 		// 服务器内部出现错误
 		case HTTP_CODE::INTERNAL_ERROR:
@@ -601,7 +853,6 @@ bool http_connection::add_response(const char *format, ...) {
     _write_idx += len;
 	// 清空可变参列表
     va_end(arg_list);
-    LOG_INFO("request: ", _write_buf);
-    log::get_instance()->flush();
+    LOG_SAMPLED(LOG_LEVEL::INFO, 100, "request: {}", _write_buf);
     return true;
 }
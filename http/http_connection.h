@@ -20,7 +20,10 @@
 #include <errno.h>
 #include <sys/wait.h>
 #include <sys/uio.h>
+#include <chrono>
 #include "../pool/connection_pool.h"
+#include "../pool/coroutine.h"
+#include "../store/registration_writer.h"
 
 // http连接类
 class http_connection {
@@ -30,6 +33,8 @@ class http_connection {
 		// 读写缓冲区大小
 		static const int READ_BUFFER_SIZE = 2048;
 		static const int WRITE_BUFFER_SIZE = 1024;
+		// 主线程直接发送的资源文件大小上限，超过该大小的文件交由工作线程处理
+		static const int INLINE_FILE_SIZE = 64 * 1024;
 		// 请求方法：GET、POST（本项目只用到了这两种）
 		enum class REQUEST_METHOD { GET, POST };
 		// http状态码：请求尚未完整、获得了完整请求、存在语法错误、服务器内部错误
@@ -44,7 +49,7 @@ class http_connection {
 	public:
 		static int _epollfd; // epoll对象的文件描述符
 		static int _user_count; // 连接的客户端的数量
-		MYSQL *_mysql; // 数据库连接
+		static io_scheduler *_scheduler; // 协程调度器，登录/注册等待数据库时由其恢复协程，为nullptr时阻塞等待
 
 	private:
 		int _sockfd; // 与客户端连接的文件描述符
@@ -64,12 +69,15 @@ class http_connection {
 		REQUEST_METHOD _request_method; // 请求方法
 		bool _cgi; // 请求方式是否为POST
 		char *_url; // 请求资源的url
+		char _request_target[FILE_NAME_SIZE]; // 请求行中原始的url，_url在处理请求时会被改写，访问日志记录该副本
 		char *_version; // http版本号
 
 		// 请求头中的字段
 		char *_host; // 服务器的域名
 		int _content_length; // 记录请求数据的长度，若为POST方式，则该值大于0
 		bool _linger; // 连接管理（长连接：keep-alive、短连接：close）
+		char *_referer; // 来源页面，仅用于访问日志
+		char *_user_agent; // 客户端标识，仅用于访问日志
 
 		char _real_file[FILE_NAME_SIZE]; // 请求资源的文件路径
 		char *_file_address; // 请求资源的文件所映射到的内存地址
@@ -84,6 +92,17 @@ class http_connection {
 		int _bytes_sent; // 已发送的字节数
 		int _bytes_left; // 剩余待发送的字节数
 
+		bool _inline; // 请求是否正在主线程中处理
+		bool _deferred; // 请求已在主线程中解析完毕，但需交由工作线程执行，或为登录/注册请求，需交由协程执行
+
+		// 访问日志记录的响应状态码和各阶段耗时
+		int _status; // 响应状态码
+		std::chrono::steady_clock::time_point _time_ready; // 请求数据读取完毕（或推迟交由工作线程）的时间
+		std::chrono::steady_clock::time_point _time_responded; // 开始生成响应报文的时间
+		std::chrono::nanoseconds _queue_time; // 在任务队列中等待的耗时
+		std::chrono::nanoseconds _parse_time; // 解析请求报文的耗时
+		std::chrono::nanoseconds _exec_time; // 执行请求的耗时
+
 	public:
 		// 使用默认合成的构造函数和析构函数
 		http_connection() = default;
@@ -96,12 +115,24 @@ class http_connection {
 		// 关闭连接，将与客户端连接的文件描述符从epoll内核事件表中移除
 		void close_connection(bool real_close = true);
 
-		// 从数据库中检索出所有的用户数据，用于登录校验
-		void init_mysql_result(connection_pool *conn_pool);
+		// 加载用户数据，用于登录校验，snapshot_path为快照文件路径，为空时从数据库检索所有用户
+		void init_mysql_result(connection_pool *conn_pool, const std::string &snapshot_path = "");
+		// 按需加载模式：不预先加载用户数据，登录和注册时才检索，capacity为缓存的用户数上限
+		void init_mysql_cache(connection_pool *conn_pool, std::size_t capacity);
+		// 启动注册用户的后台写入线程，ack为注册的持久化确认方式
+		void init_mysql_writer(connection_pool *conn_pool, REGISTER_ACK ack);
+		// 停止后台同步用户数据，并写入队列中剩余的注册用户，需在销毁连接池之前调用
+		void close_mysql_result();
 
 		// 由工作线程执行的任务处理函数，完成对报文的解析和响应
 		void process();
 
+		// 由主线程直接处理无需阻塞操作的请求，若需访问数据库或发送大文件则返回false
+		bool process_inline();
+
+		// 工作线程读模式下，由工作线程读取客户数据并处理请求
+		void read_and_process();
+
 		// 从套接字中读取客户数据，有LT和ET两种模式
 		// LT模式下，每次调用可读一部分数据，无需一次性收取所有数据
 		// ET模式下，每次调用必须通过循环来将所有数据一次性接收干净
@@ -110,6 +141,13 @@ class http_connection {
 		// 将响应报文写入并发送给客户端浏览器
 		bool write();
 
+		// 任务队列已满时，由主线程直接向客户端发送预生成的503响应报文
+		void reject_busy();
+
+		// 根据已读取的数据粗略判断该请求是否需要访问数据库，供主线程选择线程池的任务车道
+		// 本项目中只有POST请求（登录/注册校验）会访问数据库
+		bool need_database() const { return strncasecmp(_read_buf, "POST", 4) == 0; }
+
 		// 获取客户端的socket地址?
 		sockaddr_in* get_address() { return &_address; }
 
@@ -117,6 +155,9 @@ class http_connection {
 		// 初始化新接受的连接?
 		void init();
 
+		// 关闭socket的读写，并重新注册读事件，使主线程检测到EPOLLHUP后统一回收连接
+		void shutdown_connection();
+
 		// 利用主从状态机解析请求报文（请求行、请求头、请求数据）
 		HTTP_CODE process_read();
 		// 从状态机：用于解析一行数据（将行尾结束符由\r\n替换为\0\0）
@@ -130,11 +171,18 @@ class http_connection {
 
 		// 执行客户端请求，根据不同的请求执行对应的操作
 		HTTP_CODE exec_request();
+		// 在协程中执行登录/注册校验，等待数据库期间挂起协程而不占用工作线程，之后执行请求并发送响应
+		task<void> process_cgi();
+		// 解析请求报文，并分别统计解析和执行请求的耗时
+		HTTP_CODE timed_process_read();
+		HTTP_CODE timed_exec_request();
+		// 响应发送完毕（或发送失败）时，按采样率写入访问日志
+		void log_access();
 
 		// 根据http状态码向写缓冲区中写入响应报文
 		bool process_write(HTTP_CODE ret);
 		// 生成响应报文的状态行（http版本号、状态码、状态消息）
-		bool add_status_line(int status, const char *title) { return add_response("%s %d %s\r\n", "HTTP/1.1", status, title); }
+		bool add_status_line(int status, const char *title) { _status = status; return add_response("%s %d %s\r\n", "HTTP/1.1", status, title); }
 		// 生成响应报文的消息头（content-length响应正文长度、connection连接管理）
 		bool add_headers(int content_length) { return add_response("Content-Length:%d\r\nConnection:%s\r\n", content_length, (_linger ? "keep-alive" : "close")); }
 		// 生成响应报文的空行
@@ -0,0 +1,143 @@
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include "../pool/thread_pool.h"
+
+// 读取模式的基准测试：比较主线程读取数据（工作线程只处理请求）与工作线程读取数据并处理请求两种模式
+// 使用socketpair模拟客户连接，客户端发送固定大小的请求体，服务端读取完整后计算校验和并回复1字节的确认
+// 服务端的连接均注册EPOLLONESHOT事件，由处理完请求的线程重新注册，与服务器的事件处理方式一致
+
+typedef std::chrono::steady_clock clock_type;
+
+const int conn_number = 64;
+const int client_threads = 4;
+const int worker_threads = 4;
+const std::size_t total_bytes = 64 * 1024 * 1024;
+
+// 服务端的连接状态
+struct connection {
+	int id;
+	int fd;
+	std::vector<char> buf;
+	std::size_t received;
+};
+
+static int epollfd;
+static std::atomic<std::size_t> completed;
+
+// 重新注册连接的EPOLLONESHOT读事件，事件数据为连接的下标
+void rearm(const connection &conn) {
+	epoll_event event;
+	event.data.u32 = conn.id;
+	event.events = EPOLLIN | EPOLLONESHOT;
+	epoll_ctl(epollfd, EPOLL_CTL_MOD, conn.fd, &event);
+}
+
+// 非阻塞地读取数据，直到读满请求体或读缓冲区为空，返回请求体是否已读取完整
+bool read_request(connection &conn) {
+	while (conn.received < conn.buf.size()) {
+		ssize_t n = recv(conn.fd, conn.buf.data() + conn.received, conn.buf.size() - conn.received, 0);
+		if (n <= 0) break;
+		conn.received += n;
+	}
+	return conn.received == conn.buf.size();
+}
+
+// 处理完整的请求：计算校验和并回复确认，然后重新注册读事件
+void process_request(connection &conn) {
+	unsigned char sum = 0;
+	for (char c : conn.buf) sum += static_cast<unsigned char>(c);
+	conn.received = 0;
+	send(conn.fd, &sum, 1, 0);
+	++completed;
+	rearm(conn);
+}
+
+// 客户端线程，依次在各个连接上发送请求体并等待确认
+void client(std::vector<int> fds, std::size_t payload, std::size_t rounds) {
+	std::vector<char> body(payload, 'x');
+	for (std::size_t r = 0; r < rounds; ++r) {
+		for (int fd : fds) {
+			for (std::size_t sent = 0; sent < payload; ) {
+				ssize_t n = send(fd, body.data() + sent, payload - sent, 0);
+				if (n > 0) sent += n;
+			}
+		}
+		for (int fd : fds) { char ack; recv(fd, &ack, 1, 0); }
+	}
+}
+
+double run(std::size_t payload, bool worker_read) {
+	std::size_t rounds = total_bytes / payload / conn_number;
+	if (rounds == 0) rounds = 1;
+	epollfd = epoll_create(5);
+	completed = 0;
+
+	std::vector<connection> conns(conn_number);
+	std::vector<std::vector<int>> client_fds(client_threads);
+	for (int i = 0; i < conn_number; ++i) {
+		int fds[2];
+		socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+		fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+		conns[i].id = i;
+		conns[i].fd = fds[0];
+		conns[i].buf.resize(payload);
+		conns[i].received = 0;
+		client_fds[i % client_threads].push_back(fds[1]);
+		epoll_event event;
+		event.data.u32 = i;
+		event.events = EPOLLIN | EPOLLONESHOT;
+		epoll_ctl(epollfd, EPOLL_CTL_ADD, fds[0], &event);
+	}
+
+	thread_pool<void()> tpool(worker_threads, 100000);
+	auto start = clock_type::now();
+	std::vector<std::thread> clients;
+	for (int i = 0; i < client_threads; ++i)
+		clients.emplace_back(client, client_fds[i], payload, rounds);
+
+	// 主线程作为反应堆，根据模式决定由谁读取数据
+	epoll_event events[conn_number];
+	std::size_t expected = rounds * conn_number;
+	while (completed < expected) {
+		int number = epoll_wait(epollfd, events, conn_number, 10);
+		for (int i = 0; i < number; ++i) {
+			connection &conn = conns[events[i].data.u32];
+			if (worker_read) {
+				tpool.add_task([&conn]() {
+					if (read_request(conn)) process_request(conn);
+					else rearm(conn);
+				});
+			}
+			else if (read_request(conn)) tpool.add_task([&conn]() { process_request(conn); });
+			else rearm(conn);
+		}
+	}
+	double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+
+	for (std::thread &t : clients) t.join();
+	for (int i = 0; i < conn_number; ++i) close(conns[i].fd);
+	for (auto &fds : client_fds) for (int fd : fds) close(fd);
+	close(epollfd);
+	return static_cast<double>(expected * payload) / seconds / (1024 * 1024);
+}
+
+int main() {
+	std::cout << std::left << std::setw(12) << "payload" << std::setw(16) << "reactor read"
+		<< "worker read (MB/s)" << std::endl;
+	for (std::size_t payload : {1024, 16 * 1024, 128 * 1024, 1024 * 1024}) {
+		double reactor = run(payload, false);
+		double worker = run(payload, true);
+		std::cout << std::left << std::setw(12) << payload << std::fixed << std::setprecision(1)
+			<< std::setw(16) << reactor << worker << std::endl;
+	}
+	return 0;
+}
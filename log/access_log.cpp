@@ -0,0 +1,226 @@
+#include <string>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <ctime>
+#include <cstring>
+#include <charconv>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <arpa/inet.h>
+#include "access_log.h"
+
+#ifndef NDEBUG
+#include <iostream>
+#endif
+
+// 采用单例模式（懒汉式），并使用局部静态变量确保线程安全
+access_log* access_log::get_instance() {
+	static access_log logger;
+	return &logger;
+}
+
+// 根据初始化状态判断是否真的需要初始化全局唯一的访问日志对象，并确保线程安全
+void access_log::init(const std::string &file_path, ACCESS_FORMAT format, int ring_capacity) {
+	// 利用原子变量和CAS操作判断访问日志对象是否已经初始化过
+	access_status_type expected = _access_uninitialized;
+	if (!_access_status.compare_exchange_weak(expected, _access_initialized))
+		throw std::runtime_error("access log already initialized");
+
+	if (file_path.empty())
+		throw std::runtime_error("invalid file path for saving the access log");
+	if (ring_capacity <= 0)
+		throw std::runtime_error("invalid ring capacity for the access log");
+	if ((_fd = open(file_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644)) < 0)
+		throw std::runtime_error("failed to open '" + file_path + "'");
+	_file_path = file_path;
+	_format = format;
+	// 容量向上取整为2的幂，且至少能容纳4条最大长度的记录
+	_ring_capacity = 4 * _log_streambuf::max_message_size;
+	while (_ring_capacity < static_cast<std::size_t>(ring_capacity) * 1024) _ring_capacity <<= 1;
+	// 创建写线程，专门用于定时写入访问记录
+	_writer = std::thread(&access_log::async_write_log, this);
+
+#ifndef NDEBUG
+	std::cout << "\ninitialize access log..." << std::endl;
+	std::cout << "** file_path => " << _file_path << std::endl;
+	std::cout << "** ring_capacity => " << _ring_capacity << std::endl;
+#endif
+}
+
+// 每个线程各自计数，采样时无需在线程之间同步
+bool access_log::sampled(int status) {
+	if (_access_status.load(std::memory_order_acquire) != _access_initialized) return false;
+	if (status >= 400) return true;
+	thread_local unsigned count = 0;
+	return ++count % _sample_rate.load(std::memory_order_relaxed) == 0;
+}
+
+// 每个线程独占一个环形缓冲区，只在线程首次写访问记录时加锁注册
+_log_ring* access_log::local_ring() {
+	thread_local _log_ring_holder holder;
+	if (!holder.ring) {
+		holder.ring = new _log_ring(_ring_capacity);
+		std::lock_guard<std::mutex> lock(_ring_mutex);
+		_rings.push_back(holder.ring);
+		++_ring_version;
+	}
+	return holder.ring;
+}
+
+void access_log::submit(const access_record &record) {
+	thread_local _log_streambuf buf;
+	buf.reset();
+	format(buf, record);
+	std::size_t size = buf.finish();
+	if (!local_ring()->push(buf.data(), size)) _dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+namespace {
+
+// 线程独占的时间戳缓存，同一秒内的访问记录不再重复格式化
+struct _access_time_cache {
+	std::time_t second = -1;
+	char text[40];
+	std::size_t size = 0;
+};
+
+void put_time(_log_streambuf &buf, const char *fmt) {
+	thread_local _access_time_cache cache;
+	std::time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+	if (now != cache.second) {
+		std::tm local_tm;
+		localtime_r(&now, &local_tm);
+		cache.size = std::strftime(cache.text, sizeof(cache.text), fmt, &local_tm);
+		cache.second = now;
+	}
+	buf.write(cache.text, cache.size);
+}
+
+void put_number(_log_streambuf &buf, long value) {
+	char chars[24];
+	buf.write(chars, std::to_chars(chars, chars + sizeof(chars), value).ptr - chars);
+}
+
+void put_micros(_log_streambuf &buf, std::chrono::nanoseconds duration) {
+	put_number(buf, static_cast<long>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count()));
+}
+
+// 转义双引号、反斜杠和控制字符，避免客户端构造的url或请求头破坏日志格式
+// 文本格式采用\xHH（与nginx一致），JSON格式采用\u00HH
+void put_escaped(_log_streambuf &buf, const char *str, bool json) {
+	static const char hex[] = "0123456789abcdef";
+	if (!str) { buf.write("-", 1); return; }
+	for (const char *p = str; *p; ++p) {
+		unsigned char c = static_cast<unsigned char>(*p);
+		if (c == '"' || c == '\\') { char escaped[2] = {'\\', *p}; buf.write(escaped, 2); }
+		else if (c < 0x20 || c == 0x7f) {
+			if (json) { char escaped[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf]}; buf.write(escaped, 6); }
+			else { char escaped[4] = {'\\', 'x', hex[c >> 4], hex[c & 0xf]}; buf.write(escaped, 4); }
+		}
+		else buf.write(p, 1);
+	}
+}
+
+}
+
+// inet_ntop将地址写入调用者提供的缓冲区，不同于inet_ntoa的静态缓冲区，可在多个线程中同时调用
+void access_log::format(_log_streambuf &buf, const access_record &record) const {
+	char address[INET_ADDRSTRLEN];
+	if (!inet_ntop(AF_INET, &record.address.sin_addr, address, sizeof(address))) std::strcpy(address, "-");
+	auto put = [&buf](const char *str) { buf.write(str, std::strlen(str)); };
+
+	if (_format == ACCESS_FORMAT::JSON) {
+		put("{\"time\":\""); put_time(buf, "%Y-%m-%dT%H:%M:%S%z");
+		put("\",\"client\":\""); put(address);
+		put("\",\"method\":\""); put(record.method);
+		put("\",\"url\":\""); put_escaped(buf, record.url, true);
+		put("\",\"status\":"); put_number(buf, record.status);
+		put(",\"bytes\":"); put_number(buf, record.bytes);
+		put(",\"keep_alive\":"); put(record.keep_alive ? "true" : "false");
+		put(",\"referer\":\""); put_escaped(buf, record.referer, true);
+		put("\",\"user_agent\":\""); put_escaped(buf, record.user_agent, true);
+		put("\",\"queue_us\":"); put_micros(buf, record.queue);
+		put(",\"parse_us\":"); put_micros(buf, record.parse);
+		put(",\"exec_us\":"); put_micros(buf, record.exec);
+		put(",\"send_us\":"); put_micros(buf, record.send);
+		put("}\n");
+		return;
+	}
+
+	put(address); put(" - - ["); put_time(buf, "%d/%b/%Y:%H:%M:%S %z");
+	put("] \""); put(record.method); put(" "); put_escaped(buf, record.url, false);
+	put(" HTTP/1.1\" "); put_number(buf, record.status);
+	put(" "); put_number(buf, record.bytes);
+	if (_format == ACCESS_FORMAT::COMBINED) {
+		put(" \""); put_escaped(buf, record.referer, false);
+		put("\" \""); put_escaped(buf, record.user_agent, false); put("\"");
+	}
+	put(record.keep_alive ? " keep-alive" : " close");
+	put(" queue="); put_micros(buf, record.queue);
+	put(" parse="); put_micros(buf, record.parse);
+	put(" exec="); put_micros(buf, record.exec);
+	put(" send="); put_micros(buf, record.send);
+	put("\n");
+}
+
+// 作为写线程的回调函数，每隔一段时间取出所有线程的环形缓冲区中的记录，汇总后一次写入文件
+// 同时回收已退出且已取完记录的线程的环形缓冲区
+void access_log::async_write_log() {
+	ring_list_type rings;
+	std::size_t version = 0;
+	std::string batch;
+	while (true) {
+		bool stop = _writer_stop.load(std::memory_order_acquire);
+		if (_ring_version.load(std::memory_order_acquire) != version) {
+			std::lock_guard<std::mutex> lock(_ring_mutex);
+			rings = _rings;
+			version = _ring_version;
+		}
+
+		batch.clear();
+		for (_log_ring *ring : rings)
+			ring->drain([&batch](const char *data, std::size_t size, std::uint8_t) { batch.append(data, size); });
+		for (std::size_t written = 0; written < batch.size(); ) {
+			ssize_t ret = write(_fd, batch.data() + written, batch.size() - written);
+			if (ret < 0 && errno == EINTR) continue;
+			if (ret < 0) break;
+			written += static_cast<std::size_t>(ret);
+		}
+		if (stop) break;
+
+		std::unique_lock<std::mutex> ring_lock(_ring_mutex);
+		auto closed = std::partition(_rings.begin(), _rings.end(),
+				[](_log_ring *ring) { return !(ring->closed() && ring->empty()); });
+		if (closed != _rings.end()) {
+			for (auto it = closed; it != _rings.end(); ++it) delete *it;
+			_rings.erase(closed, _rings.end());
+			rings = _rings;
+			version = ++_ring_version;
+		}
+		ring_lock.unlock();
+
+		std::unique_lock<std::mutex> lock(_wait_mutex);
+		if (!_writer_stop) _wait_cond.wait_for(lock, std::chrono::milliseconds(100));
+	}
+}
+
+// 析构函数，通知写线程取完所有记录后退出，然后销毁所有环形缓冲区，并关闭访问日志文件
+access_log::~access_log() {
+	if (_writer.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(_wait_mutex);
+			_writer_stop.store(true, std::memory_order_release);
+			_wait_cond.notify_one();
+		}
+		_writer.join();
+		for (_log_ring *ring : _rings) delete ring;
+	}
+	if (_fd >= 0) close(_fd);
+#ifndef NDEBUG
+	std::cout << "** close access log => " << _file_path << " (dropped " << _dropped << ")" << std::endl;
+#endif
+}
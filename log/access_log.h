@@ -0,0 +1,96 @@
+#ifndef ACCESS_LOG_H
+#define ACCESS_LOG_H
+
+#include <netinet/in.h>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <thread>
+#include <string>
+#include <vector>
+#include <chrono>
+#include "log.h"
+
+// 访问日志格式
+// 1. COMMON：通用日志格式（CLF），host ident authuser [time] "request" status bytes
+// 2. COMBINED：组合日志格式，在CLF之后追加"referer" "user-agent"
+// 以上两种格式最后均追加各阶段耗时（微秒）：queue=排队 parse=解析 exec=执行 send=发送
+// 3. JSON：每行一个JSON对象，包含上述所有字段
+enum class ACCESS_FORMAT { COMMON, COMBINED, JSON };
+
+// 一条访问记录，由http连接在响应发送完毕（或发送失败）时填写，其中的字符串只需在submit期间有效
+struct access_record {
+	sockaddr_in address; // 客户端的socket地址
+	const char *method; // 请求方法
+	const char *url; // 请求资源的url
+	const char *referer; // 请求头中的Referer字段，没有则为nullptr
+	const char *user_agent; // 请求头中的User-Agent字段，没有则为nullptr
+	int status; // 响应状态码
+	long bytes; // 已发送的字节数（包括状态行和消息头）
+	bool keep_alive; // 是否为长连接
+	// 各阶段耗时：在任务队列中等待、解析请求报文、执行请求、发送响应报文
+	std::chrono::nanoseconds queue, parse, exec, send;
+};
+
+// 定义访问日志初始化状态类型
+typedef bool _access_status_type;
+const _access_status_type _access_initialized = true;
+const _access_status_type _access_uninitialized = false;
+
+// 访问日志，与运行日志分开写入独立的文件
+// 每个线程将格式化后的访问记录写入自己独占的环形缓冲区，缓冲区已满时直接丢弃并计数，不会阻塞请求的处理
+// 写入访问记录的线程从不唤醒写线程，写线程每隔一段时间取出所有缓冲区中的记录并一次写入文件
+// 负载较高时可通过采样率只记录部分成功的请求，出错的请求（状态码不小于400）总是记录
+class access_log {
+	private:
+		typedef _access_status_type access_status_type;
+		typedef std::vector<_log_ring*> ring_list_type;
+
+		std::string _file_path; // 访问日志文件路径
+		int _fd; // 访问日志文件的文件描述符
+		ACCESS_FORMAT _format; // 访问日志格式
+		std::atomic<unsigned> _sample_rate; // 采样率，每sample_rate个成功的请求记录一个
+		std::atomic<std::size_t> _dropped; // 因缓冲区已满而丢弃的记录数
+		std::size_t _ring_capacity; // 每个线程的环形缓冲区容量
+		ring_list_type _rings; // 所有线程的环形缓冲区
+		std::mutex _ring_mutex; // 保护环形缓冲区列表的互斥锁
+		std::atomic<std::size_t> _ring_version; // 环形缓冲区列表的版本，列表变化时递增
+		std::thread _writer; // 写线程
+		std::atomic<bool> _writer_stop; // 写线程是否需要退出
+		std::mutex _wait_mutex; // 用于定时挂起/唤醒写线程的互斥锁和条件变量
+		std::condition_variable _wait_cond;
+		// 原子变量，用于判断访问日志是否已经初始化
+		std::atomic<access_status_type> _access_status;
+
+	private:
+		// 使用单例模式，声明私有构造，并禁止拷贝操作
+		access_log() : _fd(-1), _format(ACCESS_FORMAT::COMBINED), _sample_rate(1), _dropped(0), _ring_capacity(0),
+			_ring_version(0), _writer_stop(false), _access_status(_access_uninitialized) {}
+		access_log(const access_log &rhs) = delete;
+		access_log& operator=(const access_log &rhs) = delete;
+
+		// 获取调用线程独占的环形缓冲区，线程首次调用时创建并注册
+		_log_ring* local_ring();
+		// 将访问记录按日志格式写入缓冲区
+		void format(_log_streambuf &buf, const access_record &record) const;
+		// 作为写线程的回调函数，定时取出所有环形缓冲区中的记录并写入文件
+		void async_write_log();
+
+	public:
+		// 静态成员函数，获取单例模式的实例
+		static access_log* get_instance();
+		// 初始化访问日志，需在处理请求之前调用，ring_capacity为每个线程的环形缓冲区容量（KB）
+		void init(const std::string &file_path, ACCESS_FORMAT format = ACCESS_FORMAT::COMBINED, int ring_capacity = 64);
+		// 判断是否需要记录该请求，未初始化时总是返回false，由调用者在填写访问记录之前调用
+		bool sampled(int status);
+		// 格式化访问记录并写入调用线程的环形缓冲区，缓冲区已满时丢弃
+		void submit(const access_record &record);
+		// 设置采样率，为1表示记录所有请求，可在运行期间随时修改
+		void set_sample_rate(unsigned rate) { _sample_rate.store(rate > 0 ? rate : 1, std::memory_order_relaxed); }
+		// 获取因缓冲区已满而丢弃的记录数
+		std::size_t dropped_count() const { return _dropped.load(std::memory_order_relaxed); }
+		// 析构函数，需要等待写线程取完所有记录后退出，并关闭访问日志文件
+		~access_log();
+};
+
+#endif
@@ -2,11 +2,23 @@
 #include <thread>
 #include <mutex>
 #include <chrono>
-#include <fstream>
 #include <sstream>
 #include <iomanip>
+#include <algorithm>
+#include <ctime>
+#include <cstring>
+#include <cstdlib>
 #include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <zlib.h>
 #include "log.h"
+#include "../pool/affinity.h"
 
 #ifndef NDEBUG
 #include <iostream>
@@ -19,7 +31,7 @@ log* log::get_instance() {
 }
 
 // 根据初始化状态判断是否真的需要初始化全局唯一的日志对象，并确保线程安全
-void log::init(const std::string &dir_path, int max_lines, int max_queue_capacity) {
+void log::init(const std::string &dir_path, int max_lines, int ring_capacity, bool binary, bool mapped) {
 	// 利用原子变量和CAS操作判断日志对象是否已经初始化过
 	log_status_type expected = _log_uninitialized;
 	if (!_log_status.compare_exchange_weak(expected, _log_initialized))
@@ -38,32 +50,43 @@ void log::init(const std::string &dir_path, int max_lines, int max_queue_capacit
 	// 单个日志文件可存储的最大行数
 	_max_lines = static_cast<std::size_t>(max_lines);
 
-	// 若设置了阻塞队列大小，则表示采取异步日志模式
+	_format = binary ? _binary_format : _text_format;
+	_sink = mapped ? _mmap_sink : _write_sink;
+
+	// 获取当前系统时间，计算本地时区偏移，并提取天数
+	std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
+	_utc_offset = compute_utc_offset(now);
+	_days = local_days(now);
+
+	// 分配按页对齐的批量写缓冲区
+	if (!(_batch = static_cast<char*>(std::aligned_alloc(batch_alignment, batch_capacity))))
+		throw std::runtime_error("failed to allocate memory for log batch buffer");
+	_last_sync = std::chrono::steady_clock::now();
+
+	// 创建后台切换线程，并设置日志文件路径、打开日志文件
+	_rotator.start(_dir_path, _sink == _mmap_sink ? map_chunk : 0);
+	open_file(now);
+
+	// 若设置了环形缓冲区容量，则表示采取异步日志模式
 	// 否则默认为0（或设置小于0），表示采取同步日志模式
-	if (max_queue_capacity > 0) {
+	if (ring_capacity > 0) {
 		_write_mode = _async_write;
-		if (!(_log_queue = new log_queue_type(max_queue_capacity)))
-			throw std::runtime_error("failed to allocate memory for log queue");
+		// 容量向上取整为2的幂，且至少能容纳4条最大长度的消息
+		_ring_capacity = 4 * _log_streambuf::max_message_size;
+		while (_ring_capacity < static_cast<std::size_t>(ring_capacity) * 1024) _ring_capacity <<= 1;
 		// 创建写线程，专门用于异步写入日志信息
-		std::thread(&log::async_write_log, this).detach();
+		_writer = std::thread(&log::async_write_log, this);
 	}
 
-	// 获取当前系统时间，并提取天数
-	std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
-	_days = std::chrono::duration_cast<std::chrono::days>(now.time_since_epoch());
-
-	// 设置日志文件路径并设置输出文件流对象
-	_file_path = _dir_path + "WebServer_" + get_format_time(now, "%Y-%m-%d_%H:%M:%S") + ".log";
-	_file_output.open(_file_path, std::ofstream::app);
-	if (!_file_output) throw std::runtime_error("failed to open '" + _file_path + "'");
-
 #ifndef NDEBUG
 	std::cout << "** file_path => " << _file_path << std::endl;
 	std::cout << "** max_lines => " << _max_lines << std::endl;
 	std::cout << "** cnt_lines => " << _cnt_lines << std::endl;
 	std::cout << "** days => " << _days.count() << std::endl;
-	std::cout << "** max_queue_capacity => " << max_queue_capacity << std::endl;
+	std::cout << "** ring_capacity => " << _ring_capacity << std::endl;
 	std::cout << "** write mode => " << (_write_mode == _async_write ? "async" : "sync") << std::endl;
+	std::cout << "** format => " << (_format == _binary_format ? "binary" : "text") << std::endl;
+	std::cout << "** sink => " << (_sink == _mmap_sink ? "mmap" : "write") << std::endl;
 #endif
 }
 
@@ -77,12 +100,477 @@ std::string log::get_format_time(const std::chrono::system_clock::time_point &tp
 	return fortmat_time.str();
 }
 
+std::atomic<long> log::_utc_offset(0);
+std::atomic<int> log::_level(static_cast<int>(LOG_LEVEL::DEBUG));
+
+// 计算本地时区相对UTC的偏移，localtime_r会加全局锁，因此只在初始化和切换日志文件时调用
+long log::compute_utc_offset(const std::chrono::system_clock::time_point &tp) {
+	std::time_t tmp_tm = std::chrono::system_clock::to_time_t(tp);
+	std::tm local_tm;
+	localtime_r(&tmp_tm, &local_tm);
+	return local_tm.tm_gmtoff;
+}
+
+// 获取系统时间对应的本地天数，用于按本地日期切换日志文件
+std::chrono::days log::local_days(const std::chrono::system_clock::time_point &tp) {
+	return std::chrono::floor<std::chrono::days>(tp.time_since_epoch() + std::chrono::seconds(_utc_offset.load(std::memory_order_relaxed)));
+}
+
+// 线程独占的时间戳缓存，保存最近一次格式化的本地时间（秒）及其文本
+struct _log_time_cache {
+	std::int64_t second = -1;
+	char text[26]; // "YYYY-mm-dd HH:MM:SS.uuuuuu"
+};
+
+// 将value以十进制写入width个字符，不足时高位补0
+static void put_digits(char *pos, unsigned value, int width) {
+	for (int i = width - 1; i >= 0; --i) { pos[i] = static_cast<char>('0' + value % 10); value /= 10; }
+}
+
+// 将系统时间格式化后直接写入输出流（精确到微秒），不产生临时字符串
+// 同一线程在同一秒内只需改写微秒部分，秒数变化时才根据缓存的时区偏移重新计算日期和时间
+void log::format_time(std::ostream &os, const std::chrono::system_clock::time_point &tp) {
+	thread_local _log_time_cache cache;
+	std::int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(tp.time_since_epoch()).count();
+	std::int64_t second = us / 1000000 + _utc_offset.load(std::memory_order_relaxed);
+	if (second != cache.second) {
+		std::chrono::sys_seconds local{std::chrono::seconds(second)};
+		std::chrono::sys_days day = std::chrono::floor<std::chrono::days>(local);
+		std::chrono::year_month_day ymd{day};
+		std::chrono::hh_mm_ss<std::chrono::seconds> hms{local - day};
+		char *text = cache.text;
+		put_digits(text, static_cast<unsigned>(static_cast<int>(ymd.year())), 4); text[4] = '-';
+		put_digits(text + 5, static_cast<unsigned>(ymd.month()), 2); text[7] = '-';
+		put_digits(text + 8, static_cast<unsigned>(ymd.day()), 2); text[10] = ' ';
+		put_digits(text + 11, static_cast<unsigned>(hms.hours().count()), 2); text[13] = ':';
+		put_digits(text + 14, static_cast<unsigned>(hms.minutes().count()), 2); text[16] = ':';
+		put_digits(text + 17, static_cast<unsigned>(hms.seconds().count()), 2); text[19] = '.';
+		cache.second = second;
+	}
+	put_digits(cache.text + 20, static_cast<unsigned>(us % 1000000), 6);
+	os.write(cache.text, sizeof(cache.text));
+}
+
+// 每个线程独占一个格式化流，在线程首次写日志时创建
+_log_stream& log::local_stream() {
+	thread_local _log_stream stream;
+	return stream;
+}
+
+// 每个线程独占一个环形缓冲区，只在线程首次写日志时加锁注册，此后写日志不再加锁
+_log_ring* log::local_ring() {
+	thread_local _log_ring_holder holder;
+	if (!holder.ring) {
+		holder.ring = new _log_ring(_ring_capacity);
+		std::lock_guard<std::mutex> lock(_ring_mutex);
+		_rings.push_back(holder.ring);
+		++_ring_version;
+	}
+	return holder.ring;
+}
+
+// 将消息写入调用线程的环形缓冲区，缓冲区已满时唤醒写线程并让出CPU，直到写线程腾出空间
+// 若设置为丢弃，则缓冲区已满时直接丢弃消息并计数，写日志的线程不会因写线程跟不上而停顿
+// 消息等级作为记录的标记，写线程据此判断是否需要立即同步
+void log::push(const char *data, std::size_t size, LOG_LEVEL level) {
+	_log_ring *ring = local_ring();
+	while (!ring->push(data, size, static_cast<std::uint8_t>(level))) {
+		wake_writer();
+		if (_overflow.load(std::memory_order_relaxed) == _drop_on_full) {
+			_dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		std::this_thread::yield();
+	}
+	wake_writer();
+}
+
+// 摘要消息使用自身的调用位置（而非site），使二进制日志中每个调用位置只对应一个格式字符串
+void log::write_suppressed(LOG_LEVEL level, const std::source_location &site, std::uint64_t suppressed) {
+	write_log(level, std::source_location::current(), "suppressed {} messages from {}:{}", suppressed, site.file_name(), site.line());
+}
+
+// 写线程只在取完所有消息后才会挂起，因此只有空闲时才需要加锁唤醒
+// 内存屏障确保写线程要么能看到刚写入的消息，要么被标记为挂起状态而被唤醒
+void log::wake_writer() {
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (_writer_sleeping.load(std::memory_order_relaxed)) {
+		std::lock_guard<std::mutex> lock(_wait_mutex);
+		_wait_cond.notify_one();
+	}
+}
+
+// 设置日志文件路径并打开日志文件，二进制日志文件以.blog为后缀，并在文件开头写入magic
+// 优先使用后台切换线程预先创建的文件，尚未创建完成时才直接创建，mmap后端下映射失败时退回write
+// 每个二进制日志文件都需要独立解码，因此需清空已写入的调用位置
+void log::open_file(const std::chrono::system_clock::time_point &now) {
+	_file_path = _dir_path + "WebServer_" + get_format_time(now, "%Y-%m-%d_%H:%M:%S")
+		+ (_format == _binary_format ? ".blog" : ".log");
+	if ((_fd = _rotator.take(_file_path)) < 0
+			&& (_fd = open(_file_path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644)) < 0)
+		throw std::runtime_error("failed to open '" + _file_path + "'");
+	_file_bytes = 0;
+	_map_offset = _synced_offset = 0;
+	if (_sink == _mmap_sink) map_file(map_chunk);
+	if (_format == _binary_format) {
+		append_batch(_log_binary_format::magic, sizeof(_log_binary_format::magic));
+		_sites.clear();
+	}
+}
+
+// 异步模式下写入调用线程的环形缓冲区，同步模式下加锁后直接写入日志文件
+void log::commit(const char *data, std::size_t size, LOG_LEVEL level, const std::chrono::system_clock::time_point &now) {
+	if (_write_mode == _async_write) push(data, size, level);
+	else {
+		std::lock_guard<std::mutex> lock(_mutex);
+		rotate(now);
+		write_record(data, size);
+		write_batch();
+		sync_file(level == LOG_LEVEL::ERROR);
+	}
+}
+
+// 将日志消息写入批量写缓冲区，需在写线程中或持有锁的情况下调用
+// 二进制模式下将调用位置转换为位置编号，首次出现的调用位置先写入调用位置记录（含格式字符串）
+void log::write_record(const char *data, std::size_t size) {
+	++_cnt_lines;
+	if (_format == _text_format) { append_batch(data, size); return; }
+
+	_log_binary_header header;
+	std::memcpy(&header, data, sizeof(header));
+	auto [it, inserted] = _sites.emplace(std::make_pair(header.file, header.line), static_cast<std::uint32_t>(_sites.size()));
+	std::uint32_t site = it->second;
+	if (inserted) {
+		std::uint16_t length = static_cast<std::uint16_t>(std::strlen(header.file));
+		append_batch(&_log_binary_format::site_record, 1);
+		append_batch(&site, sizeof(site));
+		append_batch(&header.line, sizeof(header.line));
+		append_batch(&length, sizeof(length));
+		append_batch(header.file, length);
+		append_batch(&header.format_size, sizeof(header.format_size));
+		append_batch(header.format, header.format_size);
+	}
+	std::uint16_t length = static_cast<std::uint16_t>(size - sizeof(header));
+	append_batch(&_log_binary_format::log_record, 1);
+	append_batch(&site, sizeof(site));
+	append_batch(&header.time, sizeof(header.time));
+	append_batch(&header.level, sizeof(header.level));
+	append_batch(&length, sizeof(length));
+	append_batch(data + sizeof(header), length);
+}
+
+// 将数据追加到批量写缓冲区，缓冲区已满时先写入日志文件，超过缓冲区容量的数据直接写入
+// 映射区域本身即为内存，因此mmap后端下直接复制到映射区域，不经过批量写缓冲区
+void log::append_batch(const void *data, std::size_t size) {
+	_file_bytes += size;
+	if (_map) { write_file(static_cast<const char*>(data), size); return; }
+	if (_batch_size + size > batch_capacity) write_batch();
+	if (size > batch_capacity) { write_file(static_cast<const char*>(data), size); return; }
+	std::memcpy(_batch + _batch_size, data, size);
+	_batch_size += size;
+}
+
+// 将批量写缓冲区中的数据通过一次write写入日志文件
+void log::write_batch() {
+	if (_batch_size == 0) return;
+	write_file(_batch, _batch_size);
+	_batch_size = 0;
+}
+
+// 将数据完整写入日志文件，被信号中断或部分写入时继续写入剩余部分，出错时丢弃剩余数据
+// mmap后端下复制到映射区域并推进尾部偏移，剩余空间不足时按块扩展映射，扩展失败（如磁盘空间不足）时丢弃数据
+void log::write_file(const char *data, std::size_t size) {
+	if (_map) {
+		std::size_t required = (_map_offset + size + map_chunk - 1) / map_chunk * map_chunk;
+		if (_map_offset + size > _map_size && !map_file(required)) return;
+		std::memcpy(_map + _map_offset, data, size);
+		_map_offset += size;
+		_unsynced_bytes += size;
+		return;
+	}
+	while (size > 0) {
+		ssize_t ret = write(_fd, data, size);
+		if (ret < 0) {
+			if (errno == EINTR) continue;
+			break;
+		}
+		data += ret;
+		size -= static_cast<std::size_t>(ret);
+		_unsynced_bytes += static_cast<std::size_t>(ret);
+	}
+}
+
+// 根据同步策略判断是否需要调用fdatasync，需在写线程中或持有锁的情况下调用
+void log::sync_file(bool error, bool force) {
+	if (_unsynced_bytes == 0) { _flush_requested.store(false, std::memory_order_relaxed); return; }
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	long interval = _sync_interval.load(std::memory_order_relaxed);
+	std::size_t bytes = _sync_bytes.load(std::memory_order_relaxed);
+	bool due = force || _flush_requested.exchange(false, std::memory_order_relaxed)
+		|| (error && _sync_on_error.load(std::memory_order_relaxed))
+		|| (bytes > 0 && _unsynced_bytes >= bytes)
+		|| (interval > 0 && now - _last_sync >= std::chrono::milliseconds(interval));
+	if (!due) return;
+	if (_map) {
+		// msync的起始地址需按页对齐
+		static const std::size_t page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+		std::size_t start = _synced_offset / page_size * page_size;
+		msync(_map + start, _map_offset - start, MS_SYNC);
+		_synced_offset = _map_offset;
+	}
+	else fdatasync(_fd);
+	_unsynced_bytes = 0;
+	_last_sync = now;
+}
+
+// 通过fallocate分配磁盘空间，避免写入映射区域时因磁盘空间不足而触发SIGBUS
+// 文件系统不支持fallocate时退回ftruncate，首次映射使用mmap，之后使用mremap扩展
+bool log::map_file(std::size_t size) {
+	if (fallocate(_fd, 0, 0, static_cast<off_t>(size)) != 0
+			&& (errno != EOPNOTSUPP || ftruncate(_fd, static_cast<off_t>(size)) != 0))
+		return false;
+	void *map = _map ? mremap(_map, _map_size, size, MREMAP_MAYMOVE)
+		: mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+	if (map == MAP_FAILED) return false;
+	_map = static_cast<char*>(map);
+	_map_size = size;
+	return true;
+}
+
+// 映射区域中已写入的数据仍在页缓存中，解除映射不会丢失，之后由fdatasync持久化
+void log::unmap_file() {
+	if (!_map) return;
+	munmap(_map, _map_size);
+	ftruncate(_fd, static_cast<off_t>(_map_offset));
+	_map = nullptr;
+	_map_size = 0;
+}
+
+// 若当前天数和先前设置的天数不同，或日志文件行数/大小已经达到最大值
+// 则将批量写缓冲区中的数据写入旧的日志文件，并切换到新的日志文件
+void log::rotate(const std::chrono::system_clock::time_point &now) {
+	std::chrono::days tmp_days = local_days(now);
+	std::size_t max_bytes = _max_bytes.load(std::memory_order_relaxed);
+	if (tmp_days == _days && _cnt_lines < _max_lines && (max_bytes == 0 || _file_bytes < max_bytes)) return;
+	// 旧的日志文件交由后台切换线程持久化、关闭和压缩，不阻塞写线程（同步模式下为写日志的线程）
+	write_batch();
+	unmap_file();
+	_rotator.retire(_fd, _file_path);
+	_unsynced_bytes = 0;
+	_last_sync = std::chrono::steady_clock::now();
+	// 设置新日志文件路径并切换到预先创建的日志文件
+	open_file(now);
+	// 每次切换日志文件时重新计算时区偏移，以跟随夏令时等变化
+	_utc_offset = compute_utc_offset(now);
+	_days = local_days(now);
+	_cnt_lines = 0;
+}
+
 // 作为写线程的回调函数，用于异步写入日志信息
+// 每一轮依次取出所有线程的环形缓冲区中的消息，汇总到批量写缓冲区后一次写入日志文件，再按同步策略持久化
+// 同一线程的消息保持写入顺序，所有缓冲区均为空时，回收已退出线程的缓冲区，然后挂起等待新的消息
 void log::async_write_log() {
-	std::string message;
-	// 从阻塞队列中取出日志信息并写入文件输出流对象
-	while (_log_queue->pop(message))  {
+	// 按放置策略绑定CPU，若未初始化CPU亲和性则不绑定
+	cpu_affinity::get_instance()->bind_current_thread();
+	ring_list_type rings;
+	std::size_t version = 0;
+	while (true) {
+		bool stop = _writer_stop.load(std::memory_order_acquire);
+		// 环形缓冲区列表只在有线程注册时变化，因此只在版本变化时重新复制
+		if (_ring_version.load(std::memory_order_acquire) != version) {
+			std::lock_guard<std::mutex> lock(_ring_mutex);
+			rings = _rings;
+			version = _ring_version;
+		}
+
+		std::size_t count = 0;
+		bool error = false;
+		std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
+		for (_log_ring *ring : rings) {
+			count += ring->drain([this, &now, &error](const char *data, std::size_t size, std::uint8_t level) {
+				rotate(now);
+				write_record(data, size);
+				error = error || level == static_cast<std::uint8_t>(LOG_LEVEL::ERROR);
+			});
+		}
+		write_batch();
+		sync_file(error, stop && count == 0);
+		// 报告因环形缓冲区已满而丢弃的消息数，该消息写入写线程自己的环形缓冲区，在下一轮中取出
+		if (std::size_t dropped = _dropped.exchange(0, std::memory_order_relaxed); dropped > 0) {
+			LOG_WARN("dropped {} log messages because the ring buffer was full", dropped);
+			continue;
+		}
+		if (count > 0) continue;
+		if (stop) break;
+
+		// 回收已退出且已取完消息的线程的环形缓冲区
+		std::unique_lock<std::mutex> ring_lock(_ring_mutex);
+		auto closed = std::partition(_rings.begin(), _rings.end(),
+				[](_log_ring *ring) { return !(ring->closed() && ring->empty()); });
+		if (closed != _rings.end()) {
+			for (auto it = closed; it != _rings.end(); ++it) delete *it;
+			_rings.erase(closed, _rings.end());
+			rings = _rings;
+			version = ++_ring_version;
+		}
+		ring_lock.unlock();
+
+		// 标记为挂起状态后再次检查所有缓冲区，避免错过挂起前刚写入的消息
+		std::unique_lock<std::mutex> lock(_wait_mutex);
+		_writer_sleeping.store(true, std::memory_order_seq_cst);
+		bool empty = std::all_of(rings.begin(), rings.end(), [](_log_ring *ring) { return ring->empty(); });
+		// 启用了定时同步时，挂起的时间不超过同步间隔，以便按时持久化已写入的数据
+		long interval = _sync_interval.load(std::memory_order_relaxed);
+		std::chrono::milliseconds timeout(interval > 0 && interval < 100 ? interval : 100);
+		if (empty && _ring_version == version && !_writer_stop && !_flush_requested)
+			_wait_cond.wait_for(lock, timeout);
+		_writer_sleeping.store(false, std::memory_order_relaxed);
+	}
+}
+
+// 析构函数，通知写线程取完所有消息后退出，然后销毁所有环形缓冲区，并持久化后关闭日志文件
+log::~log() {
+#ifndef NDEBUG
+	std::cout << "\ndestroy logger..." << std::endl;
+#endif
+	if (_writer.joinable()) {
+		_writer_stop.store(true, std::memory_order_release);
+		{
+			std::lock_guard<std::mutex> lock(_wait_mutex);
+			_wait_cond.notify_one();
+		}
+		_writer.join();
+#ifndef NDEBUG
+		std::cout << "** deallocate log rings => " << _rings.size() << std::endl;
+#endif
+		for (_log_ring *ring : _rings) delete ring;
+	}
+	if (_fd >= 0) {
+		write_batch();
+		unmap_file();
+		sync_file(false, true);
+		close(_fd);
+	}
+	// 等待后台切换线程处理完所有旧的日志文件
+	_rotator.stop();
+	std::free(_batch);
+#ifndef NDEBUG
+	std::cout << "** close file => " << _file_path << std::endl;
+#endif
+}
+
+// 创建后台切换线程，并请求预先创建第一个日志文件
+void _log_rotator::start(const std::string &dir_path, std::size_t preallocate) {
+	_dir_path = dir_path;
+	_preallocate = preallocate;
+	_next_path = dir_path + ".WebServer.next";
+	_prepare = true;
+	_thread = std::thread(&_log_rotator::run, this);
+}
+
+// 重命名只修改目录项，切换日志文件时不再等待文件创建
+int _log_rotator::take(const std::string &path) {
+	int fd = _next_fd.exchange(-1);
+	if (fd < 0) return -1;
+	if (rename(_next_path.c_str(), path.c_str()) != 0) { close(fd); fd = -1; }
+	std::lock_guard<std::mutex> lock(_mutex);
+	_prepare = true;
+	_cond.notify_one();
+	return fd;
+}
+
+void _log_rotator::retire(int fd, const std::string &path) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	_retired.emplace_back(fd, path);
+	_cond.notify_one();
+}
+
+void _log_rotator::stop() {
+	if (!_thread.joinable()) return;
+	{
 		std::lock_guard<std::mutex> lock(_mutex);
-		_file_output << message;
+		_stop = true;
+		_cond.notify_one();
+	}
+	_thread.join();
+	int fd = _next_fd.exchange(-1);
+	if (fd >= 0) { close(fd); unlink(_next_path.c_str()); }
+}
+
+// 降低调度优先级和I/O优先级，避免压缩等操作与工作线程和写线程争抢CPU和磁盘
+// 先创建下一个日志文件，再处理旧的日志文件，使切换尽快可用
+void _log_rotator::run() {
+	setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19);
+	// ioprio_set(IOPRIO_WHO_PROCESS, 0, IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 0))，glibc未提供封装
+	syscall(SYS_ioprio_set, 1, 0, 3 << 13);
+
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (true) {
+		_cond.wait(lock, [this]() { return _prepare || !_retired.empty() || _stop; });
+		if (_prepare && !_stop) {
+			_prepare = false;
+			lock.unlock();
+			int fd = open(_next_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+			if (fd >= 0 && _preallocate > 0) fallocate(fd, 0, 0, static_cast<off_t>(_preallocate));
+			if (fd >= 0) _next_fd.store(fd);
+			lock.lock();
+		}
+		else if (!_retired.empty()) {
+			retired_type retired = std::move(_retired.front());
+			_retired.pop_front();
+			lock.unlock();
+			finish(retired.first, retired.second);
+			lock.lock();
+		}
+		else break;
+	}
+}
+
+void _log_rotator::finish(int fd, const std::string &path) {
+	fdatasync(fd);
+	close(fd);
+	if (_compress.load(std::memory_order_relaxed)) compress_file(path);
+	if (_max_files.load(std::memory_order_relaxed) > 0) remove_expired(path);
+#ifndef NDEBUG
+	std::cout << "** rotate file => " << path << std::endl;
+#endif
+}
+
+// 压缩失败时删除不完整的.gz文件并保留原文件
+bool _log_rotator::compress_file(const std::string &path) {
+	int input = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (input < 0) return false;
+	std::string gz_path = path + ".gz";
+	gzFile output = gzopen(gz_path.c_str(), "wb");
+	bool ok = output != nullptr;
+	char buffer[64 * 1024];
+	ssize_t ret;
+	while (ok && (ret = read(input, buffer, sizeof(buffer))) != 0) {
+		if (ret < 0) { ok = errno == EINTR; continue; }
+		ok = gzwrite(output, buffer, static_cast<unsigned>(ret)) == ret;
+	}
+	close(input);
+	if (output && gzclose(output) != Z_OK) ok = false;
+	unlink(ok ? path.c_str() : gz_path.c_str());
+	return ok;
+}
+
+// 日志文件名以创建时间命名，按文件名排序即为按时间排序，晚于path的文件（当前的日志文件）不参与清理
+void _log_rotator::remove_expired(const std::string &path) {
+	const std::string prefix = "WebServer_";
+	std::string name = path.substr(_dir_path.size());
+	std::string stem = name.substr(0, name.find_last_of('.'));
+	std::vector<std::string> files;
+	if (DIR *dir = opendir(_dir_path.c_str())) {
+		while (dirent *entry = readdir(dir)) {
+			std::string file = entry->d_name;
+			if (file.compare(0, prefix.size(), prefix) == 0 && file.compare(0, stem.size(), stem) <= 0)
+				files.push_back(file);
+		}
+		closedir(dir);
 	}
+	std::size_t max_files = _max_files.load(std::memory_order_relaxed);
+	if (files.size() <= max_files) return;
+	std::sort(files.begin(), files.end());
+	for (std::size_t i = 0; i + max_files < files.size(); ++i) unlink((_dir_path + files[i]).c_str());
 }
@@ -1,96 +1,188 @@
 #ifndef LOG_H
 #define LOG_H
 
-#include <deque>
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
+#include <thread>
 #include <string>
+#include <vector>
 #include <chrono>
-#include <fstream>
-#include <sstream>
+#include <ostream>
+#include <streambuf>
+#include <cstring>
+#include <cstdint>
+#include <map>
+#include <deque>
+#include <algorithm>
+#include <utility>
+#include <string_view>
+#include <type_traits>
+#include <source_location>
+#include <charconv>
 #include <stdexcept>
+#include <time.h>
 
 #ifndef NDEBUG
 #include <iostream>
 #endif
 
-// 定义阻塞队列状态类型
-typedef bool _block_queue_status_type;
-const _block_queue_status_type _queue_open = true;
-const _block_queue_status_type _queue_close = false;
-
-// 阻塞队列，用于异步写入日志信息
-template <typename T>
-class _block_queue {
+// 单生产者单消费者的无锁环形缓冲区，每个写日志的线程独占一个，由写线程统一取出
+// 每条日志消息为一条记录：4字节的记录头（高8位为标记，低24位为消息长度）+消息内容，记录按4字节对齐且不跨越缓冲区末尾
+// 若末尾剩余空间不足，则写入一条填充记录，并从缓冲区头部开始写入
+class _log_ring {
 	private:
-		typedef _block_queue_status_type queue_status_type;
-
-		// 队列状态（打开/关闭）
-		queue_status_type _queue_status;
-		// 底层容器使用双端队列
-		std::deque<T> _deque;
-		// 队列的最大容量
-		std::size_t _max_capacity;
-		// 保护队列的互斥锁
-		std::mutex _mutex;
-		// 用于生产者/消费者模型的条件变量，需要搭配互斥锁一起使用
-		std::condition_variable _cond_producer;
-		std::condition_variable _cond_consumer;
-	
+		// 填充记录的长度标记
+		static const std::uint32_t _padding = 0xffffffff;
+
+		char *_buffer; // 缓冲区
+		std::size_t _capacity; // 缓冲区容量，为2的幂
+		// 生产者的写入位置和消费者的读取位置，均单调递增，分别位于不同的缓存行以避免伪共享
+		alignas(64) std::atomic<std::size_t> _head;
+		alignas(64) std::atomic<std::size_t> _tail;
+		// 所属线程是否已经退出，退出后由写线程取完剩余消息并销毁
+		std::atomic<bool> _closed;
+
+		static std::size_t align(std::size_t size) { return (size + 3) & ~static_cast<std::size_t>(3); }
+
 	public:
-		// 构造函数
-		explicit _block_queue(int max_capacity = 1000);
-		// 析构函数
-		~_block_queue();
-
-		// 队列的添加/删除元素的操作
-		void push(const T &item);
-		bool pop(T &item);
+		// 构造函数，capacity需为2的幂
+		explicit _log_ring(std::size_t capacity)
+			: _buffer(new char[capacity]), _capacity(capacity), _head(0), _tail(0), _closed(false) {}
+		~_log_ring() { delete [] _buffer; }
+		_log_ring(const _log_ring &rhs) = delete;
+		_log_ring& operator=(const _log_ring &rhs) = delete;
+
+		// 由所属线程调用，写入一条消息及其标记（如消息等级），缓冲区已满时返回false
+		bool push(const char *data, std::size_t size, std::uint8_t tag = 0);
+		// 由写线程调用，依次将所有已写入的消息及其标记交给consumer处理，返回处理的消息数
+		template <typename Consumer> std::size_t drain(Consumer &&consumer);
+
+		bool empty() const { return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_relaxed); }
+		void close() { _closed.store(true, std::memory_order_release); }
+		bool closed() const { return _closed.load(std::memory_order_acquire); }
 };
 
-// 构造函数
-template <typename T>
-_block_queue<T>::_block_queue(int max_capacity) : _queue_status(_queue_open) {
-	if (max_capacity <= 0)
-		throw std::runtime_error("invalid number of max_capacity");
-	_max_capacity = static_cast<std::size_t>(max_capacity);
-}
+// 线程退出时将其环形缓冲区标记为关闭，由写线程取完剩余消息后销毁
+struct _log_ring_holder {
+	_log_ring *ring = nullptr;
+	~_log_ring_holder() { if (ring) ring->close(); }
+};
 
-// 析构函数，关闭队列并唤醒所有阻塞的线程（生产者/消费者）
-template <typename T>
-_block_queue<T>::~_block_queue() {
-	std::unique_lock<std::mutex> lock(_mutex);
-	_deque.clear();
-	_queue_status = _queue_close;
-	lock.unlock();
-	_cond_producer.notify_all();
-	_cond_consumer.notify_all();
+// 写入一条消息，只有所属线程会修改写入位置，因此无需加锁
+inline bool _log_ring::push(const char *data, std::size_t size, std::uint8_t tag) {
+	std::size_t need = align(sizeof(std::uint32_t) + size);
+	std::size_t head = _head.load(std::memory_order_relaxed);
+	std::size_t offset = head & (_capacity - 1);
+	std::size_t contiguous = _capacity - offset;
+	// 末尾剩余空间不足时，需额外占用末尾的剩余空间作为填充
+	std::size_t total = need <= contiguous ? need : contiguous + need;
+	if (head + total - _tail.load(std::memory_order_acquire) > _capacity) return false;
+	if (need > contiguous) {
+		std::memcpy(_buffer + offset, &_padding, sizeof(_padding));
+		head += contiguous;
+		offset = 0;
+	}
+	std::uint32_t record = static_cast<std::uint32_t>(size) | static_cast<std::uint32_t>(tag) << 24;
+	std::memcpy(_buffer + offset, &record, sizeof(record));
+	std::memcpy(_buffer + offset + sizeof(record), data, size);
+	// 以release语义发布写入位置，确保写线程读取到完整的消息内容
+	_head.store(head + need, std::memory_order_release);
+	return true;
 }
 
-// 在队列尾部添加元素
-template <typename T>
-void _block_queue<T>::push(const T &item) {
-	std::unique_lock<std::mutex> lock(_mutex);
-	while (_deque.size() >= _max_capacity)
-		_cond_producer.wait(lock);
-	_deque.push_back(item);
-	_cond_consumer.notify_one();
+// 取出所有已写入的消息，处理完毕后再释放缓冲区空间
+template <typename Consumer>
+std::size_t _log_ring::drain(Consumer &&consumer) {
+	std::size_t head = _head.load(std::memory_order_acquire);
+	std::size_t tail = _tail.load(std::memory_order_relaxed);
+	std::size_t count = 0;
+	while (tail != head) {
+		std::size_t offset = tail & (_capacity - 1);
+		std::uint32_t record;
+		std::memcpy(&record, _buffer + offset, sizeof(record));
+		if (record == _padding) { tail += _capacity - offset; continue; }
+		std::size_t length = record & 0xffffff;
+		consumer(_buffer + offset + sizeof(record), length, static_cast<std::uint8_t>(record >> 24));
+		tail += align(sizeof(record) + length);
+		++count;
+	}
+	_tail.store(tail, std::memory_order_release);
+	return count;
 }
 
-// 取出队列头部元素，并将元素值赋给引用传递的item
-template <typename T>
-bool _block_queue<T>::pop(T &item) {
-	std::unique_lock<std::mutex> lock(_mutex);
-	while (_deque.empty()) {
-		_cond_consumer.wait(lock);
-		if (_queue_status == _queue_close) return false;
-	}
-	item = _deque.front();
-	_deque.pop_front();
-	_cond_producer.notify_one();
-	return true;
-}
+// 固定大小的流缓冲区，用于在线程独占的内存中格式化日志消息，超出容量的部分被截断
+class _log_streambuf : public std::streambuf {
+	public:
+		// 单条日志消息的最大长度
+		static const std::size_t max_message_size = 4096;
+
+	private:
+		char _buffer[max_message_size];
+
+	public:
+		_log_streambuf() { reset(); }
+		// 清空缓冲区，并保留最后一个字节，用于在消息被截断时补充换行符
+		void reset() { setp(_buffer, _buffer + max_message_size - 1); }
+		// 确保消息以换行符结尾，并返回消息长度
+		std::size_t finish() {
+			std::size_t size = this->size();
+			if (size == 0 || _buffer[size - 1] != '\n') _buffer[size++] = '\n';
+			return size;
+		}
+		// 写入原始字节，剩余空间不足时不写入并返回false
+		bool append(const void *data, std::size_t size) {
+			if (available() < size) return false;
+			sputn(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+			return true;
+		}
+		// 写入字符串，超出剩余空间的部分被截断
+		void write(const char *data, std::size_t size) { sputn(data, static_cast<std::streamsize>(std::min(size, available()))); }
+		// 直接在缓冲区中写入数据后，将写入位置后移size个字节
+		void advance(std::size_t size) { pbump(static_cast<int>(size)); }
+		const char* data() const { return _buffer; }
+		char* current() { return pptr(); }
+		std::size_t size() const { return static_cast<std::size_t>(pptr() - pbase()); }
+		std::size_t available() const { return static_cast<std::size_t>(epptr() - pptr()); }
+};
+
+// 线程独占的日志消息格式化流
+struct _log_stream {
+	_log_streambuf buf;
+	std::ostream os{&buf};
+
+	void reset() { buf.reset(); os.clear(); }
+};
+
+// 二进制日志的格式，写入日志消息的线程只记录调用位置、原始时间戳和原始参数，由logdecode离线解码为文本
+// 日志文件以magic开头，其后为两种记录：
+// 1. 调用位置记录：'S' | 位置编号(u32) | 行号(u32) | 文件名长度(u16) | 文件名 | 格式字符串长度(u16) | 格式字符串
+// 2. 日志消息记录：'R' | 位置编号(u32) | 时间戳(i64，纳秒) | 消息等级(u8) | 参数长度(u16) | 参数
+// 格式字符串只在调用位置记录中写入一次，日志消息记录中只包含参数
+// 每个参数以1字节的类型标记开头，其后为原始数据，字符串为长度(u16)+内容
+// 同一日志文件中，调用位置记录总是在首次引用该位置的日志消息记录之前写入
+struct _log_binary_format {
+	static constexpr char magic[8] = {'W', 'S', 'B', 'L', 'O', 'G', '2', '\n'};
+	static constexpr char site_record = 'S';
+	static constexpr char log_record = 'R';
+	static constexpr char int_arg = 'i';
+	static constexpr char uint_arg = 'u';
+	static constexpr char float_arg = 'f';
+	static constexpr char char_arg = 'c';
+	static constexpr char bool_arg = 'b';
+	static constexpr char string_arg = 's';
+	static constexpr char pointer_arg = 'p';
+};
+
+// 二进制模式下，环形缓冲区中每条消息的头部，文件名指针由写线程转换为位置编号
+struct _log_binary_header {
+	std::int64_t time; // 系统时间（纳秒）
+	const char *file; // 调用位置的文件名
+	const char *format; // 格式字符串，编译期检查保证其具有静态存储期
+	std::uint16_t format_size; // 格式字符串长度
+	std::uint32_t line; // 调用位置的行号
+	std::uint8_t level; // 消息等级
+};
 
 // 定义日志初始化状态类型
 typedef bool _log_status_type;
@@ -102,31 +194,256 @@ typedef bool _log_write_mode_type;
 const _log_write_mode_type _async_write = true;
 const _log_write_mode_type _sync_write = false;
 
+// 定义日志格式类型
+typedef bool _log_format_type;
+const _log_format_type _text_format = true;
+const _log_format_type _binary_format = false;
+
+// 定义环形缓冲区已满时的处理方式类型：等待写线程腾出空间，或直接丢弃消息
+typedef bool _log_overflow_type;
+const _log_overflow_type _block_on_full = true;
+const _log_overflow_type _drop_on_full = false;
+
+// 定义日志文件写入方式（后端）类型
+// 1. write：汇总到批量写缓冲区后通过write写入，通过fdatasync持久化
+// 2. mmap：通过fallocate预先分配并映射日志文件，直接复制到映射区域，通过msync持久化
+typedef bool _log_sink_type;
+const _log_sink_type _write_sink = true;
+const _log_sink_type _mmap_sink = false;
+
+// 编译期检查的格式字符串，与std::format类似，以{}作为参数的占位符，{{和}}分别表示{和}
+// 构造函数为consteval函数，占位符有误或与参数个数不一致时，调用非constexpr函数导致编译错误
+// 编译错误信息中的函数名即为错误原因，且格式字符串只能是具有静态存储期的常量（如字符串字面值）
+template <typename... Args>
+struct _log_format_string {
+	std::string_view str;
+
+	template <typename T> requires std::is_convertible_v<const T&, std::string_view>
+	consteval _log_format_string(const T &s) : str(s) {
+		std::size_t count = 0;
+		for (std::size_t i = 0; i < str.size(); ++i) {
+			if (str[i] == '{') {
+				if (i + 1 < str.size() && str[i + 1] == '{') ++i;
+				else if (i + 1 < str.size() && str[i + 1] == '}') { ++i; ++count; }
+				else log_format_error_invalid_placeholder();
+			}
+			else if (str[i] == '}') {
+				if (i + 1 < str.size() && str[i + 1] == '}') ++i;
+				else log_format_error_unmatched_brace();
+			}
+		}
+		if (count != sizeof...(Args)) log_format_error_argument_count_mismatch();
+	}
+
+	static void log_format_error_invalid_placeholder() {}
+	static void log_format_error_unmatched_brace() {}
+	static void log_format_error_argument_count_mismatch() {}
+};
+
+// 使格式字符串的类型不参与模板参数推导，参数类型只由实际参数推导
+template <typename... Args>
+using log_format_string = _log_format_string<std::type_identity_t<Args>...>;
+
+// 从pos开始输出格式字符串中的文本（将{{和}}还原为{和}），直到下一个占位符或结尾，pos移动到占位符之后
+template <typename Output>
+void _log_format_literal(std::string_view fmt, std::size_t &pos, Output &&output) {
+	std::size_t start = pos;
+	while (pos < fmt.size()) {
+		if (fmt[pos] == '{' || fmt[pos] == '}') {
+			output(fmt.data() + start, pos - start);
+			bool placeholder = fmt[pos] == '{' && fmt[pos + 1] == '}';
+			if (!placeholder) output(fmt.data() + pos, 1);
+			pos += 2;
+			if (placeholder) return;
+			start = pos;
+		}
+		else ++pos;
+	}
+	output(fmt.data() + start, pos - start);
+}
+
 // 枚举类型，定义四种日志信息级别
 enum class LOG_LEVEL { DEBUG, INFO, WARN, ERROR };
 
+// 编译期的最低日志级别（0: DEBUG，1: INFO，2: WARN，3: ERROR），低于该级别的日志语句在编译时被消除
+// 可在编译时通过-D LOG_COMPILE_LEVEL=1等方式设置
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL 0
+#endif
+
+// 调用位置的限流器，采用1秒的固定时间窗口，每个时间窗口内最多允许rate条日志消息，超出的消息被抑制并计数
+// 由同一调用位置的所有线程共享，时间窗口切换时的竞争只会使该窗口多允许或少允许几条消息
+class _log_rate_limiter {
+	private:
+		std::atomic<std::int64_t> _window{-1}; // 当前时间窗口（单调时钟的秒数）
+		std::atomic<std::uint32_t> _count{0}; // 当前时间窗口内的消息数
+		std::atomic<std::uint64_t> _suppressed{0}; // 上一条允许的消息之后被抑制的消息数
+
+	public:
+		// 判断是否允许写入，允许时通过suppressed返回此前被抑制的消息数
+		bool allow(std::uint32_t rate, std::uint64_t &suppressed) {
+			// 粗粒度的单调时钟只读取vDSO中的时间，开销远小于steady_clock
+			timespec ts;
+			clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+			std::int64_t window = _window.load(std::memory_order_relaxed);
+			if (window != ts.tv_sec && _window.compare_exchange_strong(window, ts.tv_sec, std::memory_order_relaxed))
+				_count.store(0, std::memory_order_relaxed);
+			if (_count.fetch_add(1, std::memory_order_relaxed) < rate) {
+				suppressed = _suppressed.load(std::memory_order_relaxed) ? _suppressed.exchange(0, std::memory_order_relaxed) : 0;
+				return true;
+			}
+			_suppressed.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+};
+
+// 调用位置的采样器，每条日志消息以1/one_in的概率写入，未被采样的消息计数
+// 使用线程独占的xorshift伪随机数，采样时无需在线程之间同步
+class _log_sampler {
+	private:
+		std::atomic<std::uint64_t> _suppressed{0}; // 上一条被采样的消息之后未被采样的消息数
+
+		static std::uint64_t random() {
+			thread_local std::uint64_t state = reinterpret_cast<std::uintptr_t>(&state) | 1;
+			state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+			return state;
+		}
+
+	public:
+		// 判断是否被采样，被采样时通过suppressed返回此前未被采样的消息数
+		bool sample(std::uint32_t one_in, std::uint64_t &suppressed) {
+			if (one_in > 1 && random() % one_in != 0) {
+				_suppressed.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+			suppressed = _suppressed.load(std::memory_order_relaxed) ? _suppressed.exchange(0, std::memory_order_relaxed) : 0;
+			return true;
+		}
+};
+
+// 日志文件的后台切换线程，以低优先级（nice 19，空闲I/O调度类）运行，负责日志切换中所有耗时的文件操作：
+// 1. 预先创建（并按需通过fallocate预先分配）下一个日志文件（目录下的隐藏文件.WebServer.next），切换时只需重命名并交换文件描述符
+// 2. 持久化并关闭旧的日志文件，按需使用zlib压缩为.gz文件
+// 3. 按保留数量删除最旧的已切换日志文件
+class _log_rotator {
+	private:
+		// 旧的日志文件：文件描述符和路径
+		typedef std::pair<int, std::string> retired_type;
+
+		std::string _dir_path; // 日志文件所在的目录
+		std::string _next_path; // 预先创建的日志文件路径
+		std::atomic<int> _next_fd; // 预先创建的日志文件的文件描述符，-1表示尚未创建
+		std::size_t _preallocate; // 预先分配的字节数，为0表示不预先分配
+		std::atomic<std::size_t> _max_files; // 保留的已切换日志文件数量，为0表示不限制
+		std::atomic<bool> _compress; // 是否压缩已切换的日志文件
+		std::deque<retired_type> _retired; // 等待处理的旧日志文件
+		bool _prepare; // 是否需要预先创建下一个日志文件
+		bool _stop; // 后台线程是否需要退出
+		std::mutex _mutex; // 保护任务队列的互斥锁和条件变量
+		std::condition_variable _cond;
+		std::thread _thread; // 后台线程
+
+		// 后台线程的回调函数，依次处理预先创建和旧日志文件的任务
+		void run();
+		// 持久化并关闭旧的日志文件，按需压缩，然后按保留数量清理
+		void finish(int fd, const std::string &path);
+		// 使用zlib将日志文件压缩为.gz文件，成功后删除原文件
+		static bool compress_file(const std::string &path);
+		// 删除最旧的已切换日志文件，只保留不晚于path的最近max_files个文件
+		void remove_expired(const std::string &path);
+
+	public:
+		_log_rotator() : _next_fd(-1), _preallocate(0), _max_files(0), _compress(false), _prepare(false), _stop(false) {}
+		_log_rotator(const _log_rotator &rhs) = delete;
+		_log_rotator& operator=(const _log_rotator &rhs) = delete;
+		~_log_rotator() { stop(); }
+
+		// 创建后台线程，并预先创建第一个日志文件，preallocate为预先分配的字节数
+		void start(const std::string &dir_path, std::size_t preallocate);
+		// 设置保留数量和是否压缩
+		void set_policy(std::size_t max_files, bool compress) { _max_files = max_files; _compress = compress; }
+		// 将预先创建的日志文件重命名为path并返回其文件描述符，然后通知后台线程创建下一个，未创建完成时返回-1
+		int take(const std::string &path);
+		// 将旧的日志文件交给后台线程处理，调用后不能再使用fd
+		void retire(int fd, const std::string &path);
+		// 处理完所有旧日志文件后退出后台线程，并删除预先创建的日志文件
+		void stop();
+};
+
 // 日志类，可用于同步/异步写入日志
+// 异步模式下，每个线程将日志消息写入自己独占的环形缓冲区，写线程统一取出并写入日志文件
+// 日志文件的切换也由写线程完成，因此写入日志消息的线程既不加锁也不分配内存
+// 写线程每次取完所有缓冲区中的消息后，先汇总到按页对齐的批量写缓冲区，再通过一次write写入日志文件
+// 并按照同步策略（每隔一段时间、每写入一定字节数或写入ERROR消息时）调用fdatasync将数据持久化
+// mmap后端下，写线程直接复制到日志文件的映射区域并推进尾部偏移，不再调用write，磁盘短暂变慢时写入开销保持稳定
+// 日志文件按日期、行数和大小切换，切换时只交换预先创建的文件，旧文件的持久化、压缩和清理均由后台切换线程完成
 class log {
 	private:
 		typedef _log_status_type log_status_type;
 		typedef _log_write_mode_type write_mode_type;
-		typedef _block_queue<std::string> log_queue_type;
+		typedef _log_format_type format_type;
+		typedef _log_sink_type sink_type;
+		typedef _log_overflow_type overflow_type;
+		typedef std::vector<_log_ring*> ring_list_type;
+		// 二进制模式下，调用位置（文件名指针和行号）到位置编号的映射
+		typedef std::map<std::pair<const char*, std::uint32_t>, std::uint32_t> site_map_type;
 
 		std::string _dir_path; // 路径名
 		std::string _file_path; // 日志文件路径
 		std::size_t _max_lines; // 最大行数
 		std::size_t _cnt_lines; // 行数记录
-		std::chrono::days _days; // 记录当前时间是哪一天
+		std::atomic<std::size_t> _max_bytes; // 单个日志文件的最大字节数，为0表示不限制
+		std::size_t _file_bytes; // 当前日志文件已写入的字节数
+		std::chrono::days _days; // 记录当前时间是哪一天（本地时间）
+		// 本地时区相对UTC的偏移，在初始化和切换日志文件时计算，格式化时间戳时不再调用localtime
+		static std::atomic<long> _utc_offset;
+		// 运行时的日志级别阈值，低于该级别的日志消息在格式化之前即被丢弃
+		static std::atomic<int> _level;
 		write_mode_type _write_mode; // 写入方式
-		log_queue_type *_log_queue; // 阻塞队列
-		std::ofstream _file_output; // 文件输出流
+		format_type _format; // 日志格式
+		site_map_type _sites; // 当前日志文件中已写入的调用位置
+		int _fd; // 日志文件的文件描述符
+		char *_batch; // 批量写缓冲区，按页对齐
+		std::size_t _batch_size; // 批量写缓冲区中待写入的字节数
+		static const std::size_t batch_alignment = 4096; // 批量写缓冲区的对齐大小（页大小）
+		static const std::size_t batch_capacity = 1 << 20; // 批量写缓冲区的容量
+		sink_type _sink; // 日志文件写入方式
+		char *_map; // 日志文件的映射区域，为nullptr表示未映射
+		std::size_t _map_size; // 映射区域（及预先分配）的大小
+		std::size_t _map_offset; // 映射区域的尾部偏移，即已写入的字节数
+		std::size_t _synced_offset; // 已通过msync持久化的偏移
+		static const std::size_t map_chunk = 16 << 20; // 每次预先分配并映射的大小
 		// 原子变量，用于判断日志单例是否已经初始化
 		std::atomic<log_status_type> _log_status;
-		std::mutex _mutex; // 互斥锁
+		std::mutex _mutex; // 互斥锁，同步模式下保护日志文件
+
+		// 同步策略：每隔一段时间（毫秒）、每写入一定字节数、写入ERROR消息时调用fdatasync，为0/false表示不启用
+		std::atomic<long> _sync_interval;
+		std::atomic<std::size_t> _sync_bytes;
+		std::atomic<bool> _sync_on_error;
+		std::atomic<bool> _flush_requested; // 是否有线程请求刷新
+		std::size_t _unsynced_bytes; // 上次同步之后写入的字节数
+		std::chrono::steady_clock::time_point _last_sync; // 上次同步的时间
+
+		std::size_t _ring_capacity; // 每个线程的环形缓冲区容量
+		std::atomic<overflow_type> _overflow; // 环形缓冲区已满时的处理方式
+		std::atomic<std::size_t> _dropped; // 因环形缓冲区已满而丢弃、尚未报告的消息数
+		ring_list_type _rings; // 所有线程的环形缓冲区，只在线程首次写日志时添加
+		std::mutex _ring_mutex; // 保护环形缓冲区列表的互斥锁
+		std::atomic<std::size_t> _ring_version; // 环形缓冲区列表的版本，列表变化时递增
+		std::thread _writer; // 写线程
+		std::atomic<bool> _writer_stop; // 写线程是否需要退出
+		std::atomic<bool> _writer_sleeping; // 写线程是否处于挂起状态
+		std::mutex _wait_mutex; // 用于挂起/唤醒写线程的互斥锁和条件变量
+		std::condition_variable _wait_cond;
+		_log_rotator _rotator; // 后台切换线程
 
 	private:
 		// 使用单例模式，声明私有构造，并禁止拷贝操作
-		log() : _cnt_lines(0), _log_queue(nullptr), _log_status(_log_uninitialized) {}
+		log() : _cnt_lines(0), _max_bytes(0), _file_bytes(0), _write_mode(_sync_write), _format(_text_format), _fd(-1), _batch(nullptr), _batch_size(0),
+			_sink(_write_sink), _map(nullptr), _map_size(0), _map_offset(0), _synced_offset(0),
+			_log_status(_log_uninitialized), _sync_interval(0), _sync_bytes(0), _sync_on_error(false), _flush_requested(false),
+			_unsynced_bytes(0), _ring_capacity(0), _overflow(_block_on_full), _dropped(0), _ring_version(0), _writer_stop(false), _writer_sleeping(false) {}
 		log(const log &rhs) = delete;
 		log& operator=(const log &rhs) = delete;
 
@@ -134,113 +451,278 @@ class log {
 		// 将系统时间格式化为字符串（精确到微秒）
 		static std::string get_format_time(const std::chrono::system_clock::time_point &tp,
 				const std::string &fmt = "%Y-%m-%d %H:%M:%S");
-		// 异步写入日志信息
+		// 将系统时间格式化后直接写入输出流（精确到微秒），使用线程独占的缓存，每秒最多格式化一次日期和时间
+		static void format_time(std::ostream &os, const std::chrono::system_clock::time_point &tp);
+		// 获取系统时间对应的本地天数
+		static std::chrono::days local_days(const std::chrono::system_clock::time_point &tp);
+		// 计算本地时区相对UTC的偏移（秒）
+		static long compute_utc_offset(const std::chrono::system_clock::time_point &tp);
+		// 获取调用线程独占的日志消息格式化流
+		static _log_stream& local_stream();
+		// 获取调用线程独占的环形缓冲区，线程首次调用时创建并注册
+		_log_ring* local_ring();
+		// 获取下一个日志文件的路径，并打开日志文件
+		void open_file(const std::chrono::system_clock::time_point &now);
+		// 根据写入方式，将日志消息写入环形缓冲区或直接写入日志文件
+		void commit(const char *data, std::size_t size, LOG_LEVEL level, const std::chrono::system_clock::time_point &now);
+		// 将日志消息写入批量写缓冲区，二进制模式下转换为调用位置记录和日志消息记录
+		void write_record(const char *data, std::size_t size);
+		// 将数据追加到批量写缓冲区，缓冲区已满时先写入日志文件
+		void append_batch(const void *data, std::size_t size);
+		// 将批量写缓冲区中的数据通过一次write写入日志文件
+		void write_batch();
+		// 将数据完整写入日志文件，mmap后端下复制到映射区域
+		void write_file(const char *data, std::size_t size);
+		// 将日志文件预先分配并映射（或重新映射）为size字节，失败时保留原有的映射
+		bool map_file(std::size_t size);
+		// 解除映射，并将日志文件截断为实际写入的大小
+		void unmap_file();
+		// 根据同步策略判断是否需要调用fdatasync，error表示本次写入包含ERROR消息
+		void sync_file(bool error, bool force = false);
+		// 将格式化后的日志消息写入调用线程的环形缓冲区
+		void push(const char *data, std::size_t size, LOG_LEVEL level);
+		// 若写线程处于挂起状态，则将其唤醒
+		void wake_writer();
+		// 若日期变化或日志文件行数/大小已经达到最大值，则切换到新的日志文件
+		void rotate(const std::chrono::system_clock::time_point &now);
+		// 作为写线程的回调函数，用于异步写入日志信息
 		void async_write_log();
 		
-		// 模板成员函数，将单个对象写入字符串输出流，将作为重载的可变参版本的递归终止条件
-		// 即向文件输出流对象写入最后一个数据，并添加换行符表示该日志消息结束
+		// 模板成员函数，将单个对象格式化后直接写入缓冲区，基本类型不经过输出流，其余类型使用operator<<
 		template <typename T>
-		std::ostringstream& to_ostringstream(std::ostringstream &os, const T &t) { os << t << '\n'; return os; }
+		static void format_arg(_log_stream &stream, const T &t);
 
-		// 可变参模板，将任意类型的多个对象写入字符串输出流
-		template <typename T, typename... Args>
-		std::ostringstream& to_ostringstream(std::ostringstream &os, const T &t, const Args &...rest);
+		// 模板成员函数，二进制模式下将单个对象以原始数据的形式写入缓冲区，剩余空间不足时丢弃
+		template <typename T>
+		static void encode_arg(_log_stream &stream, const T &t);
+		// 写入字符串参数，超出剩余空间的部分被截断
+		static void encode_string(_log_streambuf &buf, std::string_view str);
 
 	public:
 		// 静态成员函数，获取单例模式的实例
 		static log* get_instance();
-		// 初始化单例模式的实例
-		void init(const std::string &dir_path, int max_lines, int max_queue_capacity = 0);
-		// 可变参模板，根据写入方式，向文件输出流对象同步/异步写入日志信息
-		template <typename... Args> void write_log(LOG_LEVEL level, const Args &...rest);
-		// 手动刷新文件输出流缓冲区
-		void flush() { _file_output << std::flush; }
-		// 析构函数，需要在内部销毁阻塞队列，并关闭文件输出流
-		~log() {
-#ifndef NDEBUG
-			std::cout << "\ndestroy logger..." << std::endl;
-#endif
-			if (_log_queue) {
-#ifndef NDEBUG
-			std::cout << "** deallocate log queue" << std::endl;
-#endif
-				delete _log_queue;
-			}
-			_file_output.close();
-#ifndef NDEBUG
-			std::cout << "** close file => " << _file_path << std::endl;
-#endif
+		// 判断该级别的日志消息是否需要写入，由日志宏在求值参数之前调用
+		static bool enabled(LOG_LEVEL level) { return static_cast<int>(level) >= _level.load(std::memory_order_relaxed); }
+		// 设置/获取运行时的日志级别阈值，可在运行期间随时修改
+		static void set_level(LOG_LEVEL level) { _level.store(static_cast<int>(level), std::memory_order_relaxed); }
+		static LOG_LEVEL get_level() { return static_cast<LOG_LEVEL>(_level.load(std::memory_order_relaxed)); }
+		// 初始化单例模式的实例，ring_capacity为每个线程的环形缓冲区容量（KB），大于0表示异步模式
+		// binary为true时采用二进制日志格式，日志文件需使用logdecode解码，mapped为true时采用mmap后端
+		void init(const std::string &dir_path, int max_lines, int ring_capacity = 0, bool binary = false, bool mapped = false);
+		// 可变参模板，根据写入方式，向日志文件同步/异步写入日志信息，site为调用位置
+		template <typename... Args>
+		void write_log(LOG_LEVEL level, const std::source_location &site, log_format_string<Args...> fmt, const Args &...rest);
+		// 设置同步策略：interval为同步间隔，bytes为同步字节数，on_error表示写入ERROR消息时立即同步
+		void set_sync_policy(std::chrono::milliseconds interval, std::size_t bytes, bool on_error) {
+			_sync_interval = interval.count(); _sync_bytes = bytes; _sync_on_error = on_error;
+		}
+		// 设置切换策略：max_bytes为单个日志文件的最大字节数，max_files为保留的已切换日志文件数量（均为0表示不限制）
+		// compress表示是否在后台将已切换的日志文件压缩为.gz文件
+		void set_rotate_policy(std::size_t max_bytes, std::size_t max_files, bool compress) {
+			_max_bytes = max_bytes; _rotator.set_policy(max_files, compress);
 		}
+		// 设置环形缓冲区已满时的处理方式，drop为true时直接丢弃消息，写线程随后输出丢弃的消息数
+		void set_drop_on_full(bool drop) { _overflow = drop ? _drop_on_full : _block_on_full; }
+		// 输出调用位置site被限流或未被采样的消息数，由限流和采样的日志宏调用
+		void write_suppressed(LOG_LEVEL level, const std::source_location &site, std::uint64_t suppressed);
+		// 请求将已写入的日志持久化，不阻塞调用线程，由写线程（同步模式下为下一次写日志的线程）完成
+		void flush() {
+			_flush_requested.store(true, std::memory_order_relaxed);
+			if (_write_mode == _async_write) wake_writer();
+		}
+		// 析构函数，需要等待写线程取完所有消息后退出，并关闭日志文件
+		~log();
 };
 
-// 可变参模板，以递归的方式将任意类型的多个对象写入字符串输出流
-// 递归终止条件为参数包被分解为只剩一个参数的状态，此时调用非可变参版本的to_ostringstream
-template <typename T, typename... Args>
-std::ostringstream& log::to_ostringstream(std::ostringstream &os, const T &t, const Args &...rest) {
-	os << t << " ";
-	return to_ostringstream(os, rest...);
+// 与std::format的默认格式一致：布尔值输出true/false，浮点数输出最短的精确表示，指针输出十六进制地址
+template <typename T>
+void log::format_arg(_log_stream &stream, const T &t) {
+	_log_streambuf &buf = stream.buf;
+	if constexpr (std::is_same_v<T, bool>) {
+		if (t) buf.write("true", 4); else buf.write("false", 5);
+	}
+	else if constexpr (std::is_same_v<T, char> || std::is_same_v<T, signed char> || std::is_same_v<T, unsigned char>) {
+		char c = static_cast<char>(t);
+		buf.write(&c, 1);
+	}
+	else if constexpr (std::is_integral_v<T> || std::is_floating_point_v<T>) {
+		std::to_chars_result result = std::to_chars(buf.current(), buf.current() + buf.available(), t);
+		if (result.ec == std::errc()) buf.advance(static_cast<std::size_t>(result.ptr - buf.current()));
+	}
+	// 字符数组（包括字符串字面量）不会为空指针，单独处理，只读取数组范围内的内容
+	else if constexpr (std::is_array_v<T> && std::is_same_v<std::remove_cv_t<std::remove_extent_t<T>>, char>) {
+		buf.write(t, strnlen(t, std::extent_v<T>));
+	}
+	else if constexpr (std::is_same_v<T, const char*> || std::is_same_v<T, char*>) {
+		if (t) buf.write(t, std::strlen(t)); else buf.write("(null)", 6);
+	}
+	else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+		std::string_view str(t);
+		buf.write(str.data(), str.size());
+	}
+	else if constexpr (std::is_pointer_v<T>) {
+		buf.write("0x", 2);
+		std::to_chars_result result = std::to_chars(buf.current(), buf.current() + buf.available(),
+				reinterpret_cast<std::uintptr_t>(t), 16);
+		if (result.ec == std::errc()) buf.advance(static_cast<std::size_t>(result.ptr - buf.current()));
+	}
+	else stream.os << t;
+}
+
+// 写入字符串参数：类型标记、长度和内容，超出剩余空间的部分被截断
+inline void log::encode_string(_log_streambuf &buf, std::string_view str) {
+	if (buf.available() < 1 + sizeof(std::uint16_t)) return;
+	std::uint16_t length = static_cast<std::uint16_t>(std::min(str.size(), buf.available() - 1 - sizeof(std::uint16_t)));
+	buf.append(&_log_binary_format::string_arg, 1);
+	buf.append(&length, sizeof(length));
+	buf.append(str.data(), length);
 }
 
-// 可变参模板，可设置日志信息级别，并将任意类型的多个对象组合成字符串形式的日志信息
+// 基本类型以原始数据的形式写入，其余类型仍通过operator<<格式化为字符串后写入
+template <typename T>
+void log::encode_arg(_log_stream &stream, const T &t) {
+	_log_streambuf &buf = stream.buf;
+	char value[1 + sizeof(std::uint64_t)];
+	std::size_t size = 0;
+	if constexpr (std::is_same_v<T, bool>) {
+		value[0] = _log_binary_format::bool_arg; value[1] = t; size = 2;
+	}
+	else if constexpr (std::is_same_v<T, char> || std::is_same_v<T, signed char> || std::is_same_v<T, unsigned char>) {
+		value[0] = _log_binary_format::char_arg; value[1] = static_cast<char>(t); size = 2;
+	}
+	else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+		std::int64_t v = t;
+		value[0] = _log_binary_format::int_arg; std::memcpy(value + 1, &v, sizeof(v)); size = 1 + sizeof(v);
+	}
+	else if constexpr (std::is_integral_v<T>) {
+		std::uint64_t v = t;
+		value[0] = _log_binary_format::uint_arg; std::memcpy(value + 1, &v, sizeof(v)); size = 1 + sizeof(v);
+	}
+	else if constexpr (std::is_floating_point_v<T>) {
+		double v = t;
+		value[0] = _log_binary_format::float_arg; std::memcpy(value + 1, &v, sizeof(v)); size = 1 + sizeof(v);
+	}
+	else if constexpr (std::is_array_v<T> && std::is_same_v<std::remove_cv_t<std::remove_extent_t<T>>, char>) {
+		encode_string(buf, std::string_view(t, strnlen(t, std::extent_v<T>)));
+		return;
+	}
+	else if constexpr (std::is_same_v<T, const char*> || std::is_same_v<T, char*>) {
+		encode_string(buf, t ? std::string_view(t) : std::string_view("(null)"));
+		return;
+	}
+	else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+		encode_string(buf, std::string_view(t));
+		return;
+	}
+	else if constexpr (std::is_pointer_v<T>) {
+		std::uint64_t v = reinterpret_cast<std::uintptr_t>(t);
+		value[0] = _log_binary_format::pointer_arg; std::memcpy(value + 1, &v, sizeof(v)); size = 1 + sizeof(v);
+	}
+	else {
+		// 先写入类型标记和长度占位，格式化完成后再回填实际长度
+		if (buf.available() < 1 + sizeof(std::uint16_t)) return;
+		buf.append(&_log_binary_format::string_arg, 1);
+		char *length_pos = buf.current();
+		std::uint16_t length = 0;
+		buf.append(&length, sizeof(length));
+		std::size_t before = buf.size();
+		stream.os << t;
+		length = static_cast<std::uint16_t>(buf.size() - before);
+		std::memcpy(length_pos, &length, sizeof(length));
+		return;
+	}
+	buf.append(value, size);
+}
+
+// 可变参模板，可设置日志信息级别，按编译期检查的格式字符串将任意类型的多个对象组合成日志信息
+// 消息直接格式化到线程独占的缓冲区中，异步模式下写入线程独占的环形缓冲区，整个过程不加锁也不分配内存
+// 二进制模式下不进行格式化，只记录调用位置（含格式字符串）、原始时间戳和原始参数
 template <typename ...Args>
-void log::write_log(LOG_LEVEL level, const Args &...rest) {
-	// 获取当前系统时间，并提取天数
+void log::write_log(LOG_LEVEL level, const std::source_location &site, log_format_string<Args...> fmt, const Args &...rest) {
 	std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
-	std::chrono::days tmp_days = std::chrono::duration_cast<std::chrono::days>(now.time_since_epoch());
-
-	// 若当前天数和先前设置的天数不同，或日志文件行数已经达到最大值
-	// 则刷新先前的缓冲区内容至日志文件，并创建新的日志文件
-	std::unique_lock<std::mutex> lock(_mutex);
-	++_cnt_lines;
-	if (tmp_days != _days || _cnt_lines >= _max_lines) {
-		// 刷新缓冲区内容至日志文件
-		_file_output << std::flush;
-		_file_output.close();
-		// 设置新日志文件路径并重置输出文件流对象
-		_file_path = _dir_path + "WebServer_" + get_format_time(now, "%Y-%m-%d_%H:%M:%S") + ".log";
-		_file_output.open(_file_path, std::ofstream::app);
-		if (!_file_output) throw std::runtime_error("failed to open '" + _file_path + "'");
-		_days = tmp_days;
-		_cnt_lines = 0;
-	}
-	lock.unlock();
-
-	// 字符串输出流，用于暂存将要写入日志文件的日志消息
-	std::ostringstream message;
+
+	_log_stream &stream = local_stream();
+	stream.reset();
+	if (_format == _binary_format) {
+		_log_binary_header header;
+		header.time = std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+		header.file = site.file_name();
+		header.format = fmt.str.data();
+		header.format_size = static_cast<std::uint16_t>(fmt.str.size());
+		header.line = site.line();
+		header.level = static_cast<std::uint8_t>(level);
+		stream.buf.append(&header, sizeof(header));
+		(encode_arg(stream, rest), ...);
+		commit(stream.buf.data(), stream.buf.size(), level, now);
+		return;
+	}
+
 	// 设置消息头中的时间部分
-	message << get_format_time(now) << " ";
+	format_time(stream.os, now);
 	// 设置消息头中的消息等级
 	switch (level) {
 		case LOG_LEVEL::DEBUG:
-			message << "[DEBUG]: ";
+			stream.buf.write(" [DEBUG]: ", 10);
 			break;
 		case LOG_LEVEL::INFO:
-			message << "[INFO]: ";
+			stream.buf.write(" [INFO]: ", 9);
 			break;
 		case LOG_LEVEL::WARN:
-			message << "[WARN]: ";
+			stream.buf.write(" [WARN]: ", 9);
 			break;
 		case LOG_LEVEL::ERROR:
-			message << "[ERROR]: ";
+			stream.buf.write(" [ERROR]: ", 10);
 			break;
 		default:
-			message << "[INFO]: ";
+			stream.buf.write(" [INFO]: ", 9);
 			break;
 	}
 
-	// 实例化可变参模板，将任意类型的多个对象所组成的消息体写入字符串输出流
-	to_ostringstream(message, rest...);
-
-	// 若为异步写入，则将消息加入阻塞队列，否则为同步写入，则将消息直接输出到文件流
-	if (_write_mode == _async_write) _log_queue->push(message.str());
-	else { lock.lock(); _file_output << message.str(); lock.unlock(); }
+	// 依次输出格式字符串中的文本和各个参数，最后输出占位符之后剩余的文本
+	std::size_t pos = 0;
+	auto literal = [&stream](const char *data, std::size_t size) { stream.buf.write(data, size); };
+	((_log_format_literal(fmt.str, pos, literal), format_arg(stream, rest)), ...);
+	_log_format_literal(fmt.str, pos, literal);
+	commit(stream.buf.data(), stream.buf.finish(), level, now);
 }
 
-// 宏函数，使写入日志消息更加便捷
-#define LOG_DEBUG(...) log::get_instance()->write_log(LOG_LEVEL::DEBUG, ##__VA_ARGS__)
-#define LOG_INFO(...) log::get_instance()->write_log(LOG_LEVEL::INFO, ##__VA_ARGS__)
-#define LOG_WARN(...) log::get_instance()->write_log(LOG_LEVEL::WARN, ##__VA_ARGS__)
-#define LOG_ERROR(...) log::get_instance()->write_log(LOG_LEVEL::ERROR, ##__VA_ARGS__)
+// 宏函数，使写入日志消息更加便捷，第一个参数为格式字符串，如LOG_INFO("close fd {}", fd)
+// 先在编译期比较最低日志级别，再在运行时比较日志级别阈值，被过滤的日志语句不会对参数求值
+#define _LOG_WRITE(level, ...) do { \
+	if constexpr (static_cast<int>(level) >= LOG_COMPILE_LEVEL) \
+		if (log::enabled(level)) log::get_instance()->write_log(level, std::source_location::current(), __VA_ARGS__); \
+} while (0)
+#define LOG_DEBUG(...) _LOG_WRITE(LOG_LEVEL::DEBUG, __VA_ARGS__)
+#define LOG_INFO(...) _LOG_WRITE(LOG_LEVEL::INFO, __VA_ARGS__)
+#define LOG_WARN(...) _LOG_WRITE(LOG_LEVEL::WARN, __VA_ARGS__)
+#define LOG_ERROR(...) _LOG_WRITE(LOG_LEVEL::ERROR, __VA_ARGS__)
 #define LOG_FLUSH() log::get_instance()->flush();
 
+// 限流和采样的日志宏，每个调用位置拥有独立的限流器/采样器，被限流或未被采样的消息不会格式化，也不会对参数求值
+// 允许写入的消息之前会先输出一条"suppressed N messages"，报告此前被抑制的消息数
+// 如LOG_RATE_LIMITED(LOG_LEVEL::ERROR, 10, "accept error: errno is: {}", errno)表示每秒最多写入10条
+// 如LOG_SAMPLED(LOG_LEVEL::INFO, 100, "close fd {}", fd)表示平均每100条写入1条
+#define LOG_RATE_LIMITED(level, rate, ...) do { \
+	if constexpr (static_cast<int>(level) >= LOG_COMPILE_LEVEL) \
+		if (log::enabled(level)) { \
+			static _log_rate_limiter _log_limiter; \
+			std::uint64_t _log_suppressed = 0; \
+			if (_log_limiter.allow(rate, _log_suppressed)) { \
+				if (_log_suppressed) log::get_instance()->write_suppressed(level, std::source_location::current(), _log_suppressed); \
+				log::get_instance()->write_log(level, std::source_location::current(), __VA_ARGS__); \
+			} \
+		} \
+} while (0)
+#define LOG_SAMPLED(level, one_in, ...) do { \
+	if constexpr (static_cast<int>(level) >= LOG_COMPILE_LEVEL) \
+		if (log::enabled(level)) { \
+			static _log_sampler _log_sample; \
+			std::uint64_t _log_suppressed = 0; \
+			if (_log_sample.sample(one_in, _log_suppressed)) { \
+				if (_log_suppressed) log::get_instance()->write_suppressed(level, std::source_location::current(), _log_suppressed); \
+				log::get_instance()->write_log(level, std::source_location::current(), __VA_ARGS__); \
+			} \
+		} \
+} while (0)
+
 #endif
@@ -0,0 +1,182 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <ctime>
+#include <cstring>
+#include <cstdint>
+#include <charconv>
+
+#include "log.h"
+
+// 二进制日志解码工具，将二进制日志文件（.blog）解码为与文本日志相同格式的文本并输出到标准输出
+// 用法：logdecode [-s] file...，-s表示在每条消息前输出调用位置（文件名:行号）
+
+// 从输入流中读取原始数据
+template <typename T>
+bool read_value(std::istream &in, T &value) {
+	return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+// 与log::format_time一致，将纳秒时间戳格式化为本地时间（精确到微秒）
+void print_time(std::ostream &os, std::int64_t time) {
+	std::chrono::system_clock::time_point tp{std::chrono::duration_cast<std::chrono::system_clock::duration>(
+			std::chrono::nanoseconds(time))};
+	std::time_t tmp_tm = std::chrono::system_clock::to_time_t(tp);
+	std::tm local_tm;
+	localtime_r(&tmp_tm, &local_tm);
+	os << std::put_time(&local_tm, "%Y-%m-%d %H:%M:%S") << "." << std::setfill('0') << std::setw(6)
+		<< (time / 1000) % 1000000 << std::setfill(' ');
+}
+
+const char* level_name(std::uint8_t level) {
+	switch (static_cast<LOG_LEVEL>(level)) {
+		case LOG_LEVEL::DEBUG: return "[DEBUG]";
+		case LOG_LEVEL::WARN: return "[WARN]";
+		case LOG_LEVEL::ERROR: return "[ERROR]";
+		default: return "[INFO]";
+	}
+}
+
+// 调用位置：文件名:行号和格式字符串
+struct site_type {
+	std::string location;
+	std::string format;
+};
+
+// 解码一个参数，格式与log::format_arg一致
+bool print_arg(std::ostream &os, const std::string &args, std::size_t &pos) {
+	auto take = [&args, &pos](void *value, std::size_t size) {
+		if (pos + size > args.size()) return false;
+		std::memcpy(value, args.data() + pos, size);
+		pos += size;
+		return true;
+	};
+	char type;
+	if (!take(&type, sizeof(type))) return false;
+	char chars[32];
+	switch (type) {
+		case _log_binary_format::int_arg: {
+			std::int64_t value;
+			if (!take(&value, sizeof(value))) return false;
+			os.write(chars, std::to_chars(chars, chars + sizeof(chars), value).ptr - chars);
+			break;
+		}
+		case _log_binary_format::uint_arg:
+		case _log_binary_format::pointer_arg: {
+			std::uint64_t value;
+			if (!take(&value, sizeof(value))) return false;
+			if (type == _log_binary_format::pointer_arg) os << "0x";
+			int base = type == _log_binary_format::pointer_arg ? 16 : 10;
+			os.write(chars, std::to_chars(chars, chars + sizeof(chars), value, base).ptr - chars);
+			break;
+		}
+		case _log_binary_format::float_arg: {
+			double value;
+			if (!take(&value, sizeof(value))) return false;
+			os.write(chars, std::to_chars(chars, chars + sizeof(chars), value).ptr - chars);
+			break;
+		}
+		case _log_binary_format::char_arg:
+		case _log_binary_format::bool_arg: {
+			char value;
+			if (!take(&value, sizeof(value))) return false;
+			if (type == _log_binary_format::char_arg) os << value;
+			else os << (value ? "true" : "false");
+			break;
+		}
+		case _log_binary_format::string_arg: {
+			std::uint16_t length;
+			if (!take(&length, sizeof(length)) || pos + length > args.size()) return false;
+			os.write(args.data() + pos, length);
+			pos += length;
+			break;
+		}
+		default:
+			return false;
+	}
+	return true;
+}
+
+// 按格式字符串依次输出文本和参数，消息被截断时只输出已记录的参数
+bool print_message(std::ostream &os, const std::string &format, const std::string &args) {
+	std::size_t fmt_pos = 0, arg_pos = 0;
+	auto literal = [&os](const char *data, std::size_t size) { os.write(data, size); };
+	_log_format_literal(format, fmt_pos, literal);
+	while (arg_pos < args.size()) {
+		if (!print_arg(os, args, arg_pos)) return false;
+		_log_format_literal(format, fmt_pos, literal);
+	}
+	return true;
+}
+
+// 解码一个二进制日志文件，文件中间再次出现magic时（追加写入同一文件）重新开始解码
+bool decode(const char *path, bool show_site) {
+	std::ifstream in(path, std::ifstream::binary);
+	if (!in) { std::cerr << "failed to open '" << path << "'" << std::endl; return false; }
+
+	std::vector<site_type> sites;
+	char record;
+	while (in.get(record)) {
+		if (record == _log_binary_format::magic[0]) {
+			char magic[sizeof(_log_binary_format::magic)] = {record};
+			in.read(magic + 1, sizeof(magic) - 1);
+			if (!in || std::memcmp(magic, _log_binary_format::magic, sizeof(magic)) != 0) break;
+			sites.clear();
+		}
+		else if (record == _log_binary_format::site_record) {
+			std::uint32_t site, line;
+			std::uint16_t length;
+			if (!read_value(in, site) || !read_value(in, line) || !read_value(in, length)) break;
+			std::string file(length, '\0');
+			if (!in.read(file.data(), length) || !read_value(in, length)) break;
+			std::string format(length, '\0');
+			if (!in.read(format.data(), length)) break;
+			if (site >= sites.size()) sites.resize(site + 1);
+			sites[site] = site_type{file + ":" + std::to_string(line), format};
+		}
+		else if (record == _log_binary_format::log_record) {
+			std::uint32_t site;
+			std::int64_t time;
+			std::uint8_t level;
+			std::uint16_t length;
+			if (!read_value(in, site) || !read_value(in, time) || !read_value(in, level) || !read_value(in, length)) break;
+			std::string args(length, '\0');
+			if (!in.read(args.data(), length)) break;
+			if (site >= sites.size()) break;
+			print_time(std::cout, time);
+			std::cout << " " << level_name(level) << ": ";
+			if (show_site) std::cout << sites[site].location << ": ";
+			// 与文本日志一致，消息不以换行符结尾时才补充换行符
+			std::ostringstream message;
+			bool ok = print_message(message, sites[site].format, args);
+			std::string text = message.str();
+			std::cout << text;
+			if (text.empty() || text.back() != '\n') std::cout << "\n";
+			if (!ok) break;
+		}
+		else break;
+	}
+	if (!in.eof()) {
+		std::cerr << "corrupted log file '" << path << "' at offset " << in.tellg() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	bool show_site = false;
+	int first = 1;
+	if (argc > 1 && std::strcmp(argv[1], "-s") == 0) { show_site = true; ++first; }
+	if (first >= argc) {
+		std::cerr << "usage: " << argv[0] << " [-s] file..." << std::endl;
+		return 1;
+	}
+	bool ok = true;
+	for (int i = first; i < argc; ++i) ok = decode(argv[i], show_site) && ok;
+	std::cout << std::flush;
+	return ok ? 0 : 1;
+}
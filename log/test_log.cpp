@@ -1,21 +1,68 @@
 #include <iostream>
+#include <string>
+#include <iomanip>
+#include <vector>
+#include <thread>
 #include <chrono>
+#include <algorithm>
 
 #include "log.h"
 
-int main() {
+// 写入一条普通的日志消息
+void write_message(int t, int i) { LOG_INFO("deal with the client({}): request {}, {} ms", t, i, 544.72); }
+
+// 多线程写日志的基准测试：统计每条日志消息在写日志线程上的平均耗时
+template <typename Write = void (*)(int, int)>
+void bench(int thread_number, int message_number, Write write = write_message) {
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	for (int t = 0; t < thread_number; ++t) {
+		threads.emplace_back([t, message_number, write]() {
+			for (int i = 0; i < message_number; ++i) write(t, i);
+		});
+	}
+	for (std::thread &thread : threads) thread.join();
+	double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	std::cout << std::left << std::setw(10) << thread_number << std::fixed << std::setprecision(1)
+		<< std::setw(12) << elapsed / message_number << " ns/msg per thread, "
+		<< thread_number * message_number / elapsed * 1000 << " M msg/s" << std::endl;
+}
+
+// 以参数binary运行时采用二进制日志格式，日志文件需使用logdecode解码，以参数mmap运行时采用mmap后端
+int main(int argc, char *argv[]) {
+	auto has_option = [argc, argv](const std::string &option) { return std::find(argv + 1, argv + argc, option) != argv + argc; };
 	auto logger = log::get_instance();
-	logger->init("./", 50, 100);
-	/* logger->write_log(log_level::info, "VARMILO", 726, 544.72); */
+	logger->init("./", 800000, 256, has_option("binary"), has_option("mmap"));
+	/* LOG_INFO("VARMILO {}", 726, 544.72); // 编译错误：占位符个数与参数个数不一致 */
 	/* logger->init("./", -50, 100); */
 	/* logger->init("./", -50, -100); */
 	/* logger->init("./", 50, 100); */
 	/* std::cout << log::get_current_time() << std::endl; */
 	for (int i = 0; i < 100; ++i) {
-		LOG_DEBUG("Hello, World!", 726, 544.72, '\n');
-		LOG_INFO("Hello, World!", 726, 544.72, '\n');
-		LOG_WARN("Hello, World!", 726, 544.72, '\n');
-		LOG_ERROR("Hello, World!", 726, 544.72, '\n');
+		LOG_DEBUG("Hello, World! {} {} {}", 726, 544.72, true);
+		LOG_INFO("Hello, World! {} {} {}", 726, 544.72, true);
+		LOG_WARN("Hello, World! {} {} {}", 726, 544.72, true);
+		LOG_ERROR("Hello, World! {} {} {}", 726, 544.72, true);
 	}
-	std::this_thread::sleep_for(std::chrono::seconds(3));
+
+	std::cout << std::left << std::setw(10) << "threads" << std::endl;
+	for (int thread_number : {1, 2, 4, 8}) bench(thread_number, 200000);
+
+	// 超出限制或未被采样的消息不会格式化，被抑制的消息数在下一条写入的消息之前输出
+	std::cout << "rate limited (100 msg/s per call site)" << std::endl;
+	bench(4, 1000000, [](int t, int i) { LOG_RATE_LIMITED(LOG_LEVEL::INFO, 100, "rate limited({}): request {}", t, i); });
+	std::cout << "sampled (1 in 1000)" << std::endl;
+	bench(4, 1000000, [](int t, int i) { LOG_SAMPLED(LOG_LEVEL::INFO, 1000, "sampled({}): request {}", t, i); });
+
+	// 环形缓冲区已满时直接丢弃消息，写日志的线程不会等待写线程，丢弃的消息数由写线程输出
+	std::cout << "drop on full" << std::endl;
+	logger->set_drop_on_full(true);
+	bench(8, 200000);
+	logger->set_drop_on_full(false);
+
+	// 被运行时日志级别过滤的日志语句不会格式化，也不会对参数求值
+	std::cout << "filtered by runtime level (WARN)" << std::endl;
+	log::set_level(LOG_LEVEL::WARN);
+	bench(1, 10000000);
+	std::this_thread::sleep_for(std::chrono::seconds(1));
 }
@@ -9,19 +9,35 @@
 #include <cassert>
 #include <sys/epoll.h>
 #include <iostream>
+#include <algorithm>
 
 #include "pool/thread_pool.h"
 #include "timer/timer.h"
 #include "http/http_connection.h"
 #include "log/log.h"
+#include "log/access_log.h"
 #include "pool/connection_pool.h"
+#include "pool/coroutine.h"
+#include "pool/affinity.h"
 
 #define MAX_FD 65536           //最大文件描述符
 #define MAX_EVENT_NUMBER 10000 //最大事件数
 #define TIMESLOT 5             //最小超时单位
 
+// 线程池的任务车道：静态资源请求、需要访问数据库的请求（登录/注册）
+#define STATIC_LANE 0
+#define DATABASE_LANE 1
+
 /* #define SYNLOG  //同步写日志 */
 #define ASYNLOG //异步写日志
+/* #define BINLOG //二进制日志格式，需使用logdecode解码 */
+/* #define MMAPLOG //通过mmap写日志文件 */
+
+/* #define LAZYUSERS //按需从数据库加载用户，只缓存活跃用户 */
+/* #define ASYNREGISTER //注册写入队列后即返回成功，不等待写入数据库，不能与LAZYUSERS同时使用 */
+
+#define RUN_TO_COMPLETION //主线程直接处理无需阻塞操作的请求
+/* #define WORKER_READ //工作线程读取客户数据，开启后运行至完成模式不生效 */
 
 /* #define listenfdLT //水平触发阻塞 */
 #define listenfdET //边缘触发非阻塞
@@ -72,8 +88,7 @@ void cb_func(client_data *user_data) {
 	user_data->timer = nullptr;
 	// **********
     http_connection::_user_count--;
-    LOG_INFO("close fd %d", user_data->sockfd);
-    log::get_instance()->flush();
+    LOG_SAMPLED(LOG_LEVEL::INFO, 100, "close fd {}", user_data->sockfd);
 }
 
 void show_error(int connfd, const char *info) {
@@ -83,16 +98,47 @@ void show_error(int connfd, const char *info) {
 }
 
 int main(int argc, char *argv[]) {
+	// 可选参数为CPU亲和性的放置策略：compact、spread或核心列表（如"0,2,4-7"）
+	// 需在创建日志写线程和工作线程之前初始化，主线程最先绑定，其后依次为日志写线程和工作线程
+	// 只有一个主线程（反应堆），compact策略下工作线程优先与主线程位于同一NUMA节点
+	// 主线程之后分配的连接数组等数据按首次访问策略位于主线程所在节点
+	if (argc > 2) {
+		cpu_affinity::get_instance()->init(argv[2]);
+		cpu_affinity::get_instance()->bind_current_thread();
+	}
+
+#ifdef BINLOG
+    const bool binary_log = true;
+#else
+    const bool binary_log = false;
+#endif
+
+#ifdef MMAPLOG
+    const bool mapped_log = true;
+#else
+    const bool mapped_log = false;
+#endif
+
 #ifdef ASYNLOG
-    log::get_instance()->init("./", 800000, 8); //异步日志模型
+    log::get_instance()->init("./", 800000, 64, binary_log, mapped_log); //异步日志模型，每个线程64KB环形缓冲区
 #endif
 
 #ifdef SYNLOG
-    log::get_instance()->init("./", 800000, 0); //同步日志模型
+    log::get_instance()->init("./", 800000, 0, binary_log, mapped_log); //同步日志模型
 #endif
+    // 环形缓冲区已满时直接丢弃日志消息，连接洪泛等过载情况下写日志不会阻塞请求的处理
+    log::get_instance()->set_drop_on_full(true);
+    // 日志持久化策略：每秒调用一次fdatasync，写入ERROR消息时立即调用
+    log::get_instance()->set_sync_policy(std::chrono::milliseconds(1000), 0, true);
+    // 日志切换策略：单个日志文件最大64MB，保留最近16个已切换的日志文件，并在后台压缩
+    log::get_instance()->set_rotate_policy(64 << 20, 16, true);
+    // 访问日志：每个请求的响应发送完毕时记录一行（组合日志格式及各阶段耗时）
+    access_log::get_instance()->init("./access.log", ACCESS_FORMAT::COMBINED);
+    // 运行时的日志级别阈值，运行期间可通过SIGUSR1/SIGUSR2信号降低/提高
+    log::set_level(LOG_LEVEL::INFO);
 
     if (argc <= 1) {
-        printf("usage: %s ip_address port_number\n", basename(argv[0]));
+        printf("usage: %s port_number [compact|spread|cpu_list]\n", basename(argv[0]));
         return 1;
     }
 
@@ -106,14 +152,37 @@ int main(int argc, char *argv[]) {
 
     // 创建线程池
     thread_pool<void()> *pool = NULL;
-    pool = new thread_pool<void()>(8,10000);
+    pool = new thread_pool<void()>(8,10000,2);
 	assert(pool);
+	// 静态资源请求的权重更高，并为其保留2个工作线程，使登录/注册请求阻塞在数据库查询时
+	// 静态资源请求的延迟不受影响
+	pool->set_lane(STATIC_LANE, 4, 2);
+	pool->set_lane(DATABASE_LANE, 1);
+	// 多核环境下，工作线程挂起前先自旋等待新任务，以减少线程唤醒的开销
+	// 单核环境下自旋会与主线程争抢CPU，因此直接挂起
+	if (std::thread::hardware_concurrency() > 1) pool->set_spin(2000);
+	// 开启弹性模式，任务排队超过5ms则扩容（最多32个线程），线程空闲超过30s则缩容（最少4个线程）
+	pool->set_elastic(4, 32, std::chrono::milliseconds(5), std::chrono::seconds(30));
+	// 记录上一次输出的线程池扩容/缩容次数，仅在发生变化时输出线程池指标
+	std::size_t last_resize_count = 0;
 
     http_connection *users = new http_connection[MAX_FD];
     assert(users);
 
-    //初始化数据库读取表
-    users->init_mysql_result(connPool);
+#ifdef LAZYUSERS
+    // 按需加载用户，最多缓存10万个活跃用户
+    users->init_mysql_cache(connPool, 100000);
+#else
+    //初始化数据库读取表，启动时映射用户快照文件，只从数据库检索快照之后新增的用户
+    users->init_mysql_result(connPool, "./users.snapshot");
+#endif
+	// 注册的用户由后台线程批量写入数据库，默认等待所在批次提交后才确认注册成功
+	// 按需加载模式下无法在内存中原子地占用用户名，始终等待提交
+#if defined(ASYNREGISTER) && !defined(LAZYUSERS)
+    users->init_mysql_writer(connPool, REGISTER_ACK::QUEUED);
+#else
+    users->init_mysql_writer(connPool, REGISTER_ACK::COMMITTED);
+#endif
 
 	// 创建监听socket文件描述符
     int listenfd = socket(PF_INET, SOCK_STREAM, 0);
@@ -154,8 +223,16 @@ int main(int argc, char *argv[]) {
     set_nonblocking(pipefd[1]);
     add_fd(epollfd, pipefd[0], false);
 
+	// 创建协程调度器，并将其内部epoll对象的文件描述符注册到epoll内核事件表中
+	// 登录/注册的协程等待数据库时挂起，数据库响应或注册批次提交后，由主线程交给线程池（数据库车道）恢复执行
+	io_scheduler *scheduler = new io_scheduler(pool, DATABASE_LANE);
+	add_fd(epollfd, scheduler->fd(), false);
+	http_connection::_scheduler = scheduler;
+
     addsig(SIGALRM, sig_handler, false);
     addsig(SIGTERM, sig_handler, false);
+    addsig(SIGUSR1, sig_handler, false);
+    addsig(SIGUSR2, sig_handler, false);
     bool stop_server = false;
 
 	// 用于保存客户端数据（IP地址、文件描述符、定时器）的数组
@@ -169,7 +246,7 @@ int main(int argc, char *argv[]) {
 		// 并将当前所有就绪事件复制到events数组中
         int number = epoll_wait(epollfd, events, MAX_EVENT_NUMBER, -1);
         if (number < 0 && errno != EINTR) {
-            LOG_ERROR("%s", "epoll failure");
+            LOG_ERROR("epoll failure");
             break;
         }
 		// 通过遍历events数组来处理已经就绪的事件
@@ -186,13 +263,13 @@ int main(int argc, char *argv[]) {
 				// accept返回新的文件描述符connfd用于收发数据
                 int connfd = accept(listenfd, (struct sockaddr *)&client_address, &client_addrlength);
                 if (connfd < 0) {
-                    LOG_ERROR("%s:errno is:%d", "accept error", errno);
+                    LOG_RATE_LIMITED(LOG_LEVEL::ERROR, 10, "accept error: errno is: {}", errno);
                     continue;
                 }
                 if (http_connection::_user_count >= MAX_FD) {
 					// 客户数量已达到上线，向新客户发送服务器繁忙信息，并关闭当前connfd
                     show_error(connfd, "Internal server busy");
-                    LOG_ERROR("%s", "Internal server busy");
+                    LOG_RATE_LIMITED(LOG_LEVEL::ERROR, 10, "Internal server busy");
                     continue;
                 }
 				// 将connfd注册到epoll内核事件表中
@@ -218,13 +295,13 @@ int main(int argc, char *argv[]) {
 					// accept返回新的文件描述符connfd用于收发数据
                     int connfd = accept(listenfd, (struct sockaddr *)&client_address, &client_addrlength);
                     if (connfd < 0) {
-                        LOG_ERROR("%s:errno is:%d", "accept error", errno);
+                        LOG_RATE_LIMITED(LOG_LEVEL::ERROR, 10, "accept error: errno is: {}", errno);
                         break;
                     }
                     if (http_connection::_user_count >= MAX_FD) {
 						// 客户数量已达到上线，向新客户发送服务器繁忙信息，并关闭当前connfd
                         show_error(connfd, "Internal server busy");
-                        LOG_ERROR("%s", "Internal server busy");
+                        LOG_RATE_LIMITED(LOG_LEVEL::ERROR, 10, "Internal server busy");
                         break;
                     }
 					// 将connfd注册到epoll内核事件表中
@@ -251,7 +328,7 @@ int main(int argc, char *argv[]) {
                 util_timer *timer = users_timer[sockfd].timer;
 				if (timer) {
 					timer->timeout_callback(&users_timer[sockfd]);
-					/* timer_manager.del_timer(timer); */
+					timer_manager.del_timer(timer);
 				}
             }
 
@@ -265,24 +342,66 @@ int main(int argc, char *argv[]) {
 					switch (signals[i]) {
 						case SIGALRM: { timeout = true; break; } // 触发超时信号
 						case SIGTERM: { stop_server = true; break; } // 触发终止服务信号
+						// SIGUSR1降低日志级别阈值（输出更多日志），SIGUSR2提高日志级别阈值（输出更少日志）
+						case SIGUSR1:
+						case SIGUSR2: {
+							int level = static_cast<int>(log::get_level()) + (signals[i] == SIGUSR1 ? -1 : 1);
+							log::set_level(static_cast<LOG_LEVEL>(std::clamp(level, 0, 3)));
+							// 该确认信息绕过运行时的级别阈值直接写入，阈值升至ERROR后仍会以WARN级别输出
+							log::get_instance()->write_log(LOG_LEVEL::WARN, std::source_location::current(),
+									"log level changed to {}", static_cast<int>(log::get_level()));
+							break;
+						}
 					}
 				}
             }
 
+			// 恢复等待数据库的协程
+            else if (sockfd == scheduler->fd()) scheduler->poll();
+
             // 处理客户连接上接收到的数据
             else if (events[i].events & EPOLLIN) {
                 util_timer *timer = users_timer[sockfd].timer;
+#ifdef WORKER_READ
+				// 工作线程读模式：主线程只检测读就绪事件，读取数据和处理请求都交由工作线程完成
+				// 使大请求体和大量并发上传的数据拷贝分散到多个CPU核心，而不是全部由主线程完成
+				// 由于尚未读取数据，无法区分请求类型，因此统一放入静态资源车道
+                if (!pool->try_add_task([users, sockfd](){ users[sockfd].read_and_process(); }, STATIC_LANE)) {
+                    users[sockfd].reject_busy();
+                    LOG_RATE_LIMITED(LOG_LEVEL::WARN, 10, "task queue is full, total rejected requests: {}", pool->full_count());
+                    if (timer) {
+                        timer->timeout_callback(&users_timer[sockfd]);
+                        timer_manager.del_timer(timer);
+                    }
+                }
+                else if (timer) {
+					timer->expire = std::chrono::high_resolution_clock::now() + 3*std::chrono::seconds(TIMESLOT);
+                    timer_manager.adjust_timer(timer);
+                }
+#else
                 if (users[sockfd].read_once()) {
-                    LOG_INFO("deal with the client(%s)", inet_ntoa(users[sockfd].get_address()->sin_addr));
-                    log::get_instance()->flush();
+#ifdef RUN_TO_COMPLETION
+					// 无需阻塞操作的请求直接在主线程中处理完毕，否则交由工作线程处理
+                    bool handled = users[sockfd].process_inline();
+#else
+                    bool handled = false;
+#endif
                     // 若监测到读事件，将该事件放入请求队列
-                    pool->add_task([users, sockfd](){ users[sockfd].process(); });
+					// 若请求队列已满，则不阻塞主线程，而是直接返回503响应报文并关闭连接
+                    int lane = users[sockfd].need_database() ? DATABASE_LANE : STATIC_LANE;
+                    if (!handled && !pool->try_add_task([users, sockfd](){ users[sockfd].process(); }, lane)) {
+                        users[sockfd].reject_busy();
+                        LOG_RATE_LIMITED(LOG_LEVEL::WARN, 10, "task queue is full, total rejected requests: {}", pool->full_count());
+                        if (timer) {
+                            timer->timeout_callback(&users_timer[sockfd]);
+                            timer_manager.del_timer(timer);
+                        }
+                    }
 
                     // 若有数据传输，则将定时器往后延迟3个单位（15s），并调整定时器在堆中的位置
-                    if (timer) {
+                    else if (timer) {
 						timer->expire = std::chrono::high_resolution_clock::now() + 3*std::chrono::seconds(TIMESLOT);
-                        LOG_INFO("%s", "adjust timer once");
-                        log::get_instance()->flush();
+                        LOG_SAMPLED(LOG_LEVEL::INFO, 100, "adjust timer once");
 						// 由于延长了定时器的超时时间，所以需要调整定时器在堆中的位置
                         timer_manager.adjust_timer(timer);
                     }
@@ -291,36 +410,44 @@ int main(int argc, char *argv[]) {
 					timer->timeout_callback(&users_timer[sockfd]);
 					timer_manager.del_timer(timer);
                 }
+#endif
             }
 
 			// 处理写入数据至客户连接
             else if (events[i].events & EPOLLOUT) {
                 util_timer *timer = users_timer[sockfd].timer;
                 if (users[sockfd].write()) {
-                    LOG_INFO("send data to the client(%s)", inet_ntoa(users[sockfd].get_address()->sin_addr));
-                    log::get_instance()->flush();
-
                     //若有数据传输，则将定时器往后延迟3个单位
                     //并对新的定时器在链表上的位置进行调整
                     if (timer) {
 						timer->expire = std::chrono::high_resolution_clock::now() + 3*std::chrono::seconds(TIMESLOT);
-                        LOG_INFO("%s", "adjust timer once");
-                        log::get_instance()->flush();
+                        LOG_SAMPLED(LOG_LEVEL::INFO, 100, "adjust timer once");
                         timer_manager.adjust_timer(timer);
                     }
                 }
                 else if (timer) {
                     timer->timeout_callback(&users_timer[sockfd]);
-                    /* timer_manager.del_timer(timer); */
+                    timer_manager.del_timer(timer);
                 }
             }
         }
-        if (timeout) { timer_handler(); timeout = false; }
+        if (timeout) {
+			timer_handler(); timeout = false;
+			// 每个定时周期检查一次线程池是否发生了扩容/缩容，若有则输出线程池指标
+			if (pool->grow_count() + pool->shrink_count() != last_resize_count) {
+				last_resize_count = pool->grow_count() + pool->shrink_count();
+				LOG_INFO("thread pool resized, size: {}, grow: {}, shrink: {}, rejected: {}",
+						pool->thread_number(), pool->grow_count(), pool->shrink_count(), pool->full_count());
+			}
+		}
     }
     close(epollfd);
     close(listenfd);
     close(pipefd[1]);
     close(pipefd[0]);
+    users->close_mysql_result();
+	// 调度器析构时等待线程池中的协程执行完毕，协程会访问连接，因此需在销毁连接之前析构
+    delete scheduler;
     delete[] users;
     delete[] users_timer;
     delete pool;
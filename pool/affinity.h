@@ -0,0 +1,160 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <sched.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <atomic>
+#include <algorithm>
+#include <stdexcept>
+
+#ifndef NDEBUG
+#include <iostream>
+#endif
+
+// 定义CPU亲和性的初始化状态类型
+typedef bool _affinity_status_type;
+const _affinity_status_type _affinity_initialized = true;
+const _affinity_status_type _affinity_uninitialized = false;
+
+// CPU亲和性，为主线程（反应堆）、日志写线程和工作线程按放置策略依次绑定CPU
+// 放置策略：
+// 1. compact：按NUMA节点顺序依次使用各节点的CPU，主线程最先绑定，因此工作线程优先与主线程位于同一节点
+// 2. spread：在各NUMA节点之间轮流选取CPU，使线程均匀分布在所有节点上
+// 3. 核心列表：如"0,2,4-7"，按列表顺序依次使用指定的CPU
+// 线程绑定CPU后，Linux默认的首次访问（first-touch）内存策略会将该线程分配并首次写入的内存
+// 放在本地节点上，因此线程在绑定之后分配的连接状态等数据不会跨节点访问
+class cpu_affinity {
+	private:
+		typedef _affinity_status_type affinity_status_type;
+
+		std::vector<int> _cpus; // 按放置策略排序的CPU列表
+		std::vector<int> _cpu_nodes; // 各CPU所属的NUMA节点（下标为CPU编号）
+		std::atomic<std::size_t> _next; // 下一个绑定的线程在CPU列表中的位置
+		// 原子变量，用于判断是否已经初始化
+		std::atomic<affinity_status_type> _affinity_status;
+
+	private:
+		// 使用单例模式，声明私有构造，并禁止拷贝操作
+		cpu_affinity() : _next(0), _affinity_status(_affinity_uninitialized) {}
+		cpu_affinity(const cpu_affinity &rhs) = delete;
+		cpu_affinity& operator=(const cpu_affinity &rhs) = delete;
+
+		// 解析CPU列表字符串（如"0,2,4-7"，与sysfs中cpulist的格式相同）
+		static std::vector<int> parse_cpu_list(const std::string &list);
+		// 读取sysfs中的NUMA拓扑，获取当前进程允许使用的各CPU所属的节点
+		void load_topology();
+
+	public:
+		// 静态成员函数，获取单例模式的实例
+		static cpu_affinity* get_instance() {
+			static cpu_affinity affinity;
+			return &affinity;
+		}
+		// 初始化放置策略，需在创建其他线程之前调用，若未初始化则不绑定任何线程
+		void init(const std::string &policy);
+		// 将调用线程绑定到放置策略中的下一个CPU上，返回绑定的CPU编号，未初始化或绑定失败则返回-1
+		int bind_current_thread();
+		// 获取CPU所属的NUMA节点
+		int node_of(int cpu) const { return cpu >= 0 && cpu < static_cast<int>(_cpu_nodes.size()) ? _cpu_nodes[cpu] : 0; }
+};
+
+// 解析CPU列表字符串，以逗号分隔，每一项为单个CPU编号或以短横线连接的闭区间
+inline std::vector<int> cpu_affinity::parse_cpu_list(const std::string &list) {
+	std::vector<int> cpus;
+	std::istringstream input(list);
+	std::string item;
+	while (std::getline(input, item, ',')) {
+		if (item.empty() || item == "\n") continue;
+		std::size_t dash = item.find('-');
+		int first = std::stoi(item.substr(0, dash));
+		int last = dash == std::string::npos ? first : std::stoi(item.substr(dash + 1));
+		if (first < 0 || last < first) throw std::runtime_error("invalid cpu list '" + list + "'");
+		for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+	}
+	return cpus;
+}
+
+// 读取sysfs中的NUMA拓扑，若系统不支持NUMA，则所有CPU都属于节点0
+inline void cpu_affinity::load_topology() {
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	sched_getaffinity(0, sizeof(allowed), &allowed);
+	_cpu_nodes.assign(CPU_SETSIZE, 0);
+
+	if (DIR *dir = opendir("/sys/devices/system/node")) {
+		while (dirent *entry = readdir(dir)) {
+			int node = 0;
+			if (sscanf(entry->d_name, "node%d", &node) != 1) continue;
+			std::ifstream input(std::string("/sys/devices/system/node/") + entry->d_name + "/cpulist");
+			std::string list;
+			std::getline(input, list);
+			for (int cpu : parse_cpu_list(list))
+				if (cpu < CPU_SETSIZE) _cpu_nodes[cpu] = node;
+		}
+		closedir(dir);
+	}
+	for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+		if (CPU_ISSET(cpu, &allowed)) _cpus.push_back(cpu);
+}
+
+// 根据放置策略生成CPU列表，且只使用当前进程允许使用的CPU（如受taskset或cgroup限制）
+inline void cpu_affinity::init(const std::string &policy) {
+	affinity_status_type expected = _affinity_uninitialized;
+	if (!_affinity_status.compare_exchange_weak(expected, _affinity_initialized))
+		throw std::runtime_error("cpu affinity already initialized");
+
+	load_topology();
+	if (policy == "compact") {
+		// 按节点排序，同一节点内按CPU编号排序
+		std::stable_sort(_cpus.begin(), _cpus.end(),
+				[this](int lhs, int rhs) { return node_of(lhs) < node_of(rhs); });
+	}
+	else if (policy == "spread") {
+		// 各节点轮流取出一个CPU，直到所有CPU都被取出
+		std::vector<std::vector<int>> nodes;
+		for (int cpu : _cpus) {
+			std::size_t node = static_cast<std::size_t>(node_of(cpu));
+			if (node >= nodes.size()) nodes.resize(node + 1);
+			nodes[node].push_back(cpu);
+		}
+		_cpus.clear();
+		for (std::size_t i = 0, taken = 1; taken; ++i) {
+			taken = 0;
+			for (std::vector<int> &node : nodes)
+				if (i < node.size()) { _cpus.push_back(node[i]); ++taken; }
+		}
+	}
+	else {
+		// 核心列表，只保留进程允许使用的CPU
+		std::vector<int> allowed = _cpus;
+		_cpus.clear();
+		for (int cpu : parse_cpu_list(policy))
+			if (std::find(allowed.begin(), allowed.end(), cpu) != allowed.end()) _cpus.push_back(cpu);
+	}
+	if (_cpus.empty()) throw std::runtime_error("no available cpu for affinity policy '" + policy + "'");
+
+#ifndef NDEBUG
+	std::cout << "\ninitialize cpu affinity..." << std::endl;
+	std::cout << "** policy => " << policy << std::endl;
+	for (int cpu : _cpus) std::cout << "** cpu " << cpu << " => node " << node_of(cpu) << std::endl;
+#endif
+}
+
+// 将调用线程绑定到放置策略中的下一个CPU上，线程数超过CPU数时循环使用
+inline int cpu_affinity::bind_current_thread() {
+	if (_affinity_status != _affinity_initialized) return -1;
+	int cpu = _cpus[_next.fetch_add(1) % _cpus.size()];
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) return -1;
+	return cpu;
+}
+
+#endif
@@ -0,0 +1,21 @@
+#include "async_query.h"
+
+#ifdef _MYSQL_NONBLOCKING
+// 以非阻塞方式执行SQL语句，语句以值传递，确保协程挂起期间语句仍然有效
+// 数据库连接的套接字在语句发送完毕前通常可写，因此只需在等待数据库响应时挂起协程直到套接字可读
+task<bool> async_query(io_scheduler *scheduler, MYSQL *conn, std::string sql) {
+	net_async_status status;
+	while ((status = mysql_real_query_nonblocking(conn, sql.c_str(), sql.size())) == NET_ASYNC_NOT_READY)
+		co_await scheduler->readable(conn->net.fd);
+	co_return status == NET_ASYNC_COMPLETE;
+}
+
+// 以非阻塞方式获取查询的结果集，失败时返回空指针
+task<MYSQL_RES*> async_store_result(io_scheduler *scheduler, MYSQL *conn) {
+	MYSQL_RES *result = nullptr;
+	net_async_status status;
+	while ((status = mysql_store_result_nonblocking(conn, &result)) == NET_ASYNC_NOT_READY)
+		co_await scheduler->readable(conn->net.fd);
+	co_return status == NET_ASYNC_COMPLETE ? result : nullptr;
+}
+#endif
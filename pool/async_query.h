@@ -0,0 +1,21 @@
+#ifndef ASYNC_QUERY_H
+#define ASYNC_QUERY_H
+
+#include <mysql/mysql.h>
+#include <string>
+#include "coroutine.h"
+
+// 非阻塞的C API（mysql_real_query_nonblocking等）自MySQL 8.0.16起才提供，MariaDB的客户端库没有这些接口
+// 因此仅在满足条件时才定义_MYSQL_NONBLOCKING并提供async_query等协程接口，否则调用者需退回到阻塞的接口
+#if !defined(MARIADB_BASE_VERSION) && defined(MYSQL_VERSION_ID) && MYSQL_VERSION_ID >= 80016
+#define _MYSQL_NONBLOCKING
+#endif
+
+#ifdef _MYSQL_NONBLOCKING
+// 以非阻塞方式执行SQL语句，等待数据库响应期间挂起协程，而不是让工作线程阻塞在mysql_query中
+task<bool> async_query(io_scheduler *scheduler, MYSQL *conn, std::string sql);
+// 以非阻塞方式获取查询的结果集
+task<MYSQL_RES*> async_store_result(io_scheduler *scheduler, MYSQL *conn);
+#endif
+
+#endif
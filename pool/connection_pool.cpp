@@ -8,6 +8,17 @@
 #include <iostream>
 #endif
 
+// 固定SQL语句的文本，顺序与SQL_STATEMENT一致
+static const std::string statement_text[] = {
+	"INSERT INTO user(username, passwd) VALUES(?, ?)",
+	"SELECT passwd FROM user WHERE username = ? LIMIT 1",
+	[]() {
+		std::string sql = "INSERT INTO user(username, passwd) VALUES(?, ?)";
+		for (std::size_t i = 1; i < sql_batch_rows; ++i) sql += ", (?, ?)";
+		return sql;
+	}(),
+};
+
 // 采用单例模式（懒汉式），并使用局部静态变量确保线程安全
 connection_pool* connection_pool::get_instance() {
 	static connection_pool conn_pool;
@@ -61,8 +72,9 @@ void connection_pool::init(const std::string &host, const std::string &user, int
 		if (conn == nullptr)
 			throw std::runtime_error("failed to establish database connection");
 
-		// 向连接池中加入一条连接
+		// 向连接池中加入一条连接，其预处理语句在首次使用时创建
 		_conn_queue.push(conn);
+		_statements[conn].fill(nullptr);
 #ifndef NDEBUG
 		std::cout << "** open mysql connection => " << conn << std::endl;
 #endif
@@ -119,6 +131,25 @@ void connection_pool::put_connection(MYSQL *conn) {
 #endif
 }
 
+// 连接同一时刻只被一个线程持有，因此可以不加锁地访问和修改其语句
+MYSQL_STMT* connection_pool::get_statement(MYSQL *conn, SQL_STATEMENT statement) {
+	auto it = _statements.find(conn);
+	if (it == _statements.end()) return nullptr;
+	std::size_t index = static_cast<std::size_t>(statement);
+	MYSQL_STMT *&stmt = it->second[index];
+	if (stmt) return stmt;
+
+	stmt = mysql_stmt_init(conn);
+	if (stmt && mysql_stmt_prepare(stmt, statement_text[index].c_str(), statement_text[index].size()) != 0) {
+#ifndef NDEBUG
+		std::cout << "** (failure) prepare statement => " << mysql_stmt_error(stmt) << std::endl;
+#endif
+		mysql_stmt_close(stmt);
+		stmt = nullptr;
+	}
+	return stmt;
+}
+
 // 销毁数据库连接池
 void connection_pool::destroy() {
 #ifndef NDEBUG
@@ -130,6 +161,10 @@ void connection_pool::destroy() {
 #ifndef NDEBUG
 		std::cout << "** close mysql connection => " << _conn_queue.front() << std::endl;
 #endif
+		// 先关闭连接上预处理的语句，再关闭连接
+		auto it = _statements.find(_conn_queue.front());
+		if (it != _statements.end())
+			for (MYSQL_STMT *stmt : it->second) if (stmt) mysql_stmt_close(stmt);
 		mysql_close(_conn_queue.front());
 		_conn_queue.pop();
 	}
@@ -4,6 +4,8 @@
 #include <mysql/mysql.h>
 #include <queue>
 #include <list>
+#include <array>
+#include <unordered_map>
 #include <string>
 #include <atomic>
 #include <mutex>
@@ -13,10 +15,19 @@ typedef bool _connection_pool_status_type;
 const _connection_pool_status_type _pool_initialized = true;
 const _connection_pool_status_type _pool_uninitialized = false;
 
+// 服务器使用的固定SQL语句：插入用户、按用户名检索密码、一次插入sql_batch_rows个用户
+enum class SQL_STATEMENT { INSERT_USER, SELECT_USER, INSERT_USER_BATCH };
+const std::size_t sql_batch_rows = 16;
+
 // 数据库连接池
+// 每条连接各自缓存服务器使用的预处理语句（MYSQL_STMT），在该连接上首次使用时才预处理，
+// 之后执行时只需绑定二进制参数，数据库无需再解析SQL语句，也无需拼接和转义参数
 class connection_pool {
 	private:
 		typedef _connection_pool_status_type pool_status_type;
+		// 固定SQL语句的数量
+		static const std::size_t statement_count = 3;
+		typedef std::array<MYSQL_STMT*, statement_count> statement_list_type;
 
 		std::string _host; // 主机地址
 		std::string _user; // 数据库用户名
@@ -30,6 +41,8 @@ class connection_pool {
 		sem_t _sem; // 信号量
 		// 使用以双向链表为底层数据结构的队列构造连接池
 		std::queue<MYSQL*, std::list<MYSQL*>> _conn_queue;
+		// 每条连接已预处理的语句，初始化后不再增删元素，连接被取出后由持有连接的线程独占访问其语句，因此无需加锁
+		std::unordered_map<MYSQL*, statement_list_type> _statements;
 
 	private:
 		// 使用单例模式，声明私有构造，并禁止拷贝操作
@@ -48,6 +61,8 @@ class connection_pool {
 		MYSQL* get_connection();
 		// 释放当前连接（加入连接池）
 		void put_connection(MYSQL *conn);
+		// 获取连接上预处理的语句，首次获取时预处理并缓存，预处理失败时返回nullptr，只能由持有连接的线程调用
+		MYSQL_STMT* get_statement(MYSQL *conn, SQL_STATEMENT statement);
 
 		// 销毁数据库连接池
 		void destroy();
@@ -72,6 +87,8 @@ class sql_connection {
 		}
 		// 通过指向连接池的指针来释放所管理的连接
 		~sql_connection() { _conn_pool->put_connection(_conn); }
+		// 获取所管理的连接上预处理的语句
+		MYSQL_STMT* statement(SQL_STATEMENT statement) const { return _conn_pool->get_statement(_conn, statement); }
 };
 
 #endif
@@ -0,0 +1,172 @@
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdexcept>
+#include "coroutine.h"
+
+#ifndef NDEBUG
+#include <iostream>
+#endif
+
+// 构造函数，创建内部epoll对象、定时器和事件，定时器的事件数据为空指针，事件的事件数据为调度器本身，以区别于等待I/O的协程
+io_scheduler::io_scheduler(pool_type *pool, int lane) : _pool(pool), _lane(lane), _retry(clock_type::time_point::max()), _running(0), _closing(false) {
+#ifndef NDEBUG
+	std::cout << "\ninitialize io scheduler..." << std::endl;
+#endif
+	if (!_pool) throw std::runtime_error("invalid thread pool for io scheduler");
+	if ((_epollfd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+		throw std::runtime_error("failed to create epoll for io scheduler");
+	if ((_timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) < 0)
+		throw std::runtime_error("failed to create timer for io scheduler");
+	if ((_eventfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+		throw std::runtime_error("failed to create eventfd for io scheduler");
+	epoll_event event;
+	event.data.ptr = nullptr;
+	event.events = EPOLLIN;
+	epoll_ctl(_epollfd, EPOLL_CTL_ADD, _timerfd, &event);
+	event.data.ptr = this;
+	epoll_ctl(_epollfd, EPOLL_CTL_ADD, _eventfd, &event);
+}
+
+// 析构函数，线程池中的协程恢复执行时仍会访问调度器（如再次co_await），因此必须等待其全部执行完毕
+// 主线程此时已不再调用poll，就绪队列中剩余的协程以阻塞的add_task交给线程池，等待期间新提交的协程同样如此
+// 最后关闭内部epoll对象、定时器和事件
+io_scheduler::~io_scheduler() {
+#ifndef NDEBUG
+	std::cout << "\ndestroy io scheduler..." << std::endl;
+#endif
+	std::unique_lock<std::mutex> lock(_ready_mutex);
+	_closing = true;
+	while (true) {
+		while (!_ready.empty()) {
+			std::coroutine_handle<> handle = _ready.front();
+			_ready.pop_front();
+			++_running;
+			lock.unlock();
+			_pool->add_task([this, handle]() { resume(handle); }, _lane);
+			lock.lock();
+		}
+		if (_running == 0) break;
+		_idle_cond.wait(lock);
+	}
+	lock.unlock();
+	close(_eventfd);
+	close(_timerfd);
+	close(_epollfd);
+}
+
+// 创建等待文件描述符可读/可写的awaiter
+io_scheduler::io_awaiter io_scheduler::readable(int fd) { return io_awaiter{this, fd, EPOLLIN, nullptr}; }
+io_scheduler::io_awaiter io_scheduler::writable(int fd) { return io_awaiter{this, fd, EPOLLOUT, nullptr}; }
+
+// 在内部epoll中注册awaiter等待的事件，并启用EPOLLONESHOT，确保协程只被恢复一次
+// 同一文件描述符再次等待时需要修改而非添加注册，因此先尝试修改，若尚未注册再添加
+// 注册之后协程随时可能在其他线程中被恢复，因此注册必须是该函数的最后一步操作
+void io_scheduler::watch(io_awaiter *awaiter) {
+	epoll_event event;
+	event.data.ptr = awaiter;
+	event.events = awaiter->_events | EPOLLONESHOT | EPOLLRDHUP;
+	if (epoll_ctl(_epollfd, EPOLL_CTL_MOD, awaiter->_fd, &event) < 0 && errno == ENOENT)
+		epoll_ctl(_epollfd, EPOLL_CTL_ADD, awaiter->_fd, &event);
+}
+
+// 取消文件描述符在内部epoll中的注册
+void io_scheduler::forget(int fd) { epoll_ctl(_epollfd, EPOLL_CTL_DEL, fd, nullptr); }
+
+// 将协程放入就绪队列并通过内部事件唤醒主线程，恢复协程不能丢弃，但也不能阻塞调用者
+// 调用者可能是主线程，若使用阻塞的add_task，线程池队列已满时将阻塞整个事件循环
+void io_scheduler::post(std::coroutine_handle<> handle) {
+	{
+		std::lock_guard<std::mutex> lock(_ready_mutex);
+		_ready.push_back(handle);
+		if (_closing) { _idle_cond.notify_all(); return; }
+	}
+	uint64_t one = 1;
+	write(_eventfd, &one, sizeof(one));
+}
+
+// 由主线程调用，取出内部epoll中所有的就绪事件，将对应的协程放入就绪队列，最后统一交给线程池恢复执行
+void io_scheduler::poll() {
+	const int max_events = 64;
+	epoll_event events[max_events];
+	int number = 0;
+	uint64_t value;
+	do {
+		number = epoll_wait(_epollfd, events, max_events, 0);
+		std::lock_guard<std::mutex> lock(_ready_mutex);
+		for (int i = 0; i < number; ++i) {
+			if (events[i].data.ptr == this) { while (read(_eventfd, &value, sizeof(value)) > 0) ; continue; }
+			if (events[i].data.ptr == nullptr) { expire_timers(); continue; }
+			_ready.push_back(static_cast<io_awaiter*>(events[i].data.ptr)->_handle);
+		}
+	} while (number == max_events);
+	dispatch();
+}
+
+// 以try_add_task将就绪队列中的协程依次交给线程池，线程池拒绝时保留剩余的协程
+// 并将内部定时器设置为1毫秒后到期，主线程届时再次调用poll重新提交，期间照常处理其他事件
+void io_scheduler::dispatch() {
+	std::unique_lock<std::mutex> lock(_ready_mutex);
+	while (!_ready.empty()) {
+		std::coroutine_handle<> handle = _ready.front();
+		++_running;
+		if (!_pool->try_add_task([this, handle]() { resume(handle); }, _lane)) { --_running; break; }
+		_ready.pop_front();
+	}
+	if (_ready.empty()) return;
+	lock.unlock();
+	std::lock_guard<std::mutex> timer_lock(_mutex);
+	clock_type::time_point retry = clock_type::now() + std::chrono::milliseconds(1);
+	if (retry < _retry) { _retry = retry; arm_timer(); }
+}
+
+// 恢复协程，协程再次挂起或结束后减少计数，计数归零时唤醒等待的析构函数
+// 唤醒前先获取就绪队列的锁，避免析构函数在检查计数与开始等待之间错过通知
+void io_scheduler::resume(std::coroutine_handle<> handle) {
+	handle.resume();
+	if (_running.fetch_sub(1) == 1) {
+		std::lock_guard<std::mutex> lock(_ready_mutex);
+		_idle_cond.notify_all();
+	}
+}
+
+// 添加一个定时器，若其为最早到期的定时器，则重新设置内部定时器
+void io_scheduler::add_timer(clock_type::time_point deadline, std::coroutine_handle<> handle) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	bool earliest = _timers.empty() || deadline < _timers.top().first;
+	_timers.emplace(deadline, handle);
+	if (earliest) arm_timer();
+}
+
+// 将所有已到期的定时器所对应的协程放入就绪队列，并将内部定时器设置为下一个到期时间
+// 由poll在持有就绪队列锁的情况下调用，重试时间在此清除，随后的dispatch仍失败时会重新设置
+void io_scheduler::expire_timers() {
+	uint64_t expirations;
+	while (read(_timerfd, &expirations, sizeof(expirations)) > 0) ;
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	clock_type::time_point now = clock_type::now();
+	while (!_timers.empty() && _timers.top().first <= now) {
+		_ready.push_back(_timers.top().second);
+		_timers.pop();
+	}
+	_retry = clock_type::time_point::max();
+	if (!_timers.empty()) arm_timer();
+}
+
+// 设置内部定时器的到期时间（绝对时间），取最早到期的定时器与重试时间中较早者
+// steady_clock在Linux上即为CLOCK_MONOTONIC
+void io_scheduler::arm_timer() {
+	clock_type::time_point earliest = _retry;
+	if (!_timers.empty() && _timers.top().first < earliest) earliest = _timers.top().first;
+	if (earliest == clock_type::time_point::max()) return;
+	std::chrono::nanoseconds deadline = earliest.time_since_epoch();
+	// 到期时间为0会解除定时器，因此至少设置为1纳秒
+	if (deadline.count() <= 0) deadline = std::chrono::nanoseconds(1);
+	itimerspec spec{};
+	spec.it_value.tv_sec = std::chrono::duration_cast<std::chrono::seconds>(deadline).count();
+	spec.it_value.tv_nsec = (deadline % std::chrono::seconds(1)).count();
+	timerfd_settime(_timerfd, TFD_TIMER_ABSTIME, &spec, nullptr);
+}
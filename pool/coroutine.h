@@ -0,0 +1,214 @@
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+#include <vector>
+#include <queue>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "thread_pool.h"
+
+template <typename T> class task;
+
+// 协程任务的promise基类，保存等待该任务完成的协程（延续）以及任务抛出的异常
+struct _task_promise_base {
+	// 任务结束时，通过对称转移直接恢复等待该任务的协程，避免递归调用导致栈溢出
+	struct final_awaiter {
+		bool await_ready() noexcept { return false; }
+		template <typename Promise>
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+			std::coroutine_handle<> continuation = handle.promise()._continuation;
+			return continuation ? continuation : std::noop_coroutine();
+		}
+		void await_resume() noexcept {}
+	};
+
+	std::coroutine_handle<> _continuation; // 等待该任务完成的协程
+	std::exception_ptr _exception; // 任务中未被捕获的异常
+
+	// 任务采用惰性启动，直到被co_await时才开始执行
+	std::suspend_always initial_suspend() noexcept { return {}; }
+	final_awaiter final_suspend() noexcept { return {}; }
+	void unhandled_exception() { _exception = std::current_exception(); }
+};
+
+// 有返回值的协程任务的promise类型
+template <typename T>
+struct _task_promise : _task_promise_base {
+	std::optional<T> _value;
+
+	task<T> get_return_object();
+	void return_value(T value) { _value.emplace(std::move(value)); }
+	T result() {
+		if (_exception) std::rethrow_exception(_exception);
+		return std::move(*_value);
+	}
+};
+
+// 无返回值的协程任务的promise类型
+template <>
+struct _task_promise<void> : _task_promise_base {
+	task<void> get_return_object();
+	void return_void() {}
+	void result() { if (_exception) std::rethrow_exception(_exception); }
+};
+
+// 协程任务类型，处理函数可通过co_await等待其他任务、套接字就绪、定时器等
+// 任务对象独占协程帧的所有权，析构时销毁协程帧，因此只能移动不能拷贝
+template <typename T = void>
+class task {
+	public:
+		typedef _task_promise<T> promise_type;
+		typedef std::coroutine_handle<promise_type> handle_type;
+
+	private:
+		handle_type _handle;
+
+	public:
+		explicit task(handle_type handle) : _handle(handle) {}
+		task(task &&rhs) noexcept : _handle(std::exchange(rhs._handle, nullptr)) {}
+		task& operator=(task &&rhs) noexcept {
+			if (this != &rhs) { if (_handle) _handle.destroy(); _handle = std::exchange(rhs._handle, nullptr); }
+			return *this;
+		}
+		task(const task &rhs) = delete;
+		task& operator=(const task &rhs) = delete;
+		~task() { if (_handle) _handle.destroy(); }
+
+		// 使任务可被co_await：记录等待者，并通过对称转移开始执行该任务
+		bool await_ready() const noexcept { return !_handle || _handle.done(); }
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept {
+			_handle.promise()._continuation = caller;
+			return _handle;
+		}
+		T await_resume() { return _handle.promise().result(); }
+};
+
+template <typename T>
+task<T> _task_promise<T>::get_return_object() { return task<T>(task<T>::handle_type::from_promise(*this)); }
+
+inline task<void> _task_promise<void>::get_return_object() { return task<void>(task<void>::handle_type::from_promise(*this)); }
+
+// 分离的协程，立即开始执行，结束后自行销毁协程帧，用于启动最外层的任务
+struct _detached_task {
+	struct promise_type {
+		_detached_task get_return_object() noexcept { return {}; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() noexcept {}
+		// 与std::thread一致，分离执行的任务中未被捕获的异常将终止程序
+		void unhandled_exception() noexcept { std::terminate(); }
+	};
+};
+
+inline _detached_task _run_detached(task<void> t) { co_await t; }
+
+// 启动一个最外层的协程任务，在调用者线程中执行到第一个挂起点为止
+inline void co_spawn(task<void> &&t) { _run_detached(std::move(t)); }
+
+// 协程调度器，将挂起的协程与线程池和主线程的epoll事件循环结合起来
+// 调度器内部拥有一个epoll对象，其文件描述符可注册到主线程的epoll内核事件表中
+// 当协程等待的套接字就绪或定时器到期时，该文件描述符变为可读，主线程调用poll
+// 将就绪的协程交给线程池恢复执行，因此少量线程即可同时挂起大量等待I/O的请求
+// 就绪的协程先放入就绪队列，再以不阻塞的try_add_task交给线程池，线程池队列已满时
+// 剩余的协程留在就绪队列中，并设置短暂的重试定时器，从而不会阻塞主线程的事件循环
+class io_scheduler {
+	private:
+		typedef thread_pool<void()> pool_type;
+		typedef std::chrono::steady_clock clock_type;
+		// 定时器元素：到期时间和到期后需要恢复的协程
+		typedef std::pair<clock_type::time_point, std::coroutine_handle<>> timer_entry;
+		typedef std::priority_queue<timer_entry, std::vector<timer_entry>, std::greater<timer_entry>> timer_queue_type;
+
+		pool_type *_pool; // 用于恢复协程的线程池
+		int _lane; // 协程在线程池中的任务车道
+		int _epollfd; // 内部epoll对象的文件描述符
+		int _timerfd; // 内部定时器的文件描述符，到期时间为最早到期的定时器或重试时间
+		int _eventfd; // 内部事件的文件描述符，其他线程提交就绪协程时用于唤醒主线程
+		timer_queue_type _timers; // 按到期时间排序的定时器
+		clock_type::time_point _retry; // 线程池拒绝任务后重新提交就绪协程的时间
+		std::mutex _mutex; // 保护定时器队列和重试时间的互斥锁
+		std::deque<std::coroutine_handle<>> _ready; // 等待交给线程池恢复执行的协程
+		std::mutex _ready_mutex; // 保护就绪队列的互斥锁
+		std::atomic<std::size_t> _running; // 已交给线程池但尚未执行完毕的协程数量
+		bool _closing; // 调度器是否正在析构，由就绪队列的互斥锁保护
+		std::condition_variable _idle_cond; // 析构时等待线程池中的协程执行完毕的条件变量
+
+	public:
+		// 切换到线程池中执行的awaiter
+		struct schedule_awaiter {
+			io_scheduler *_scheduler;
+			bool await_ready() noexcept { return false; }
+			void await_suspend(std::coroutine_handle<> handle) { _scheduler->post(handle); }
+			void await_resume() noexcept {}
+		};
+
+		// 等待文件描述符就绪的awaiter，在内部epoll中以EPOLLONESHOT注册，事件数据指向awaiter本身
+		struct io_awaiter {
+			io_scheduler *_scheduler;
+			int _fd;
+			uint32_t _events;
+			std::coroutine_handle<> _handle;
+			bool await_ready() noexcept { return false; }
+			void await_suspend(std::coroutine_handle<> handle) { _handle = handle; _scheduler->watch(this); }
+			void await_resume() noexcept {}
+		};
+
+		// 等待一段时间的awaiter
+		struct sleep_awaiter {
+			io_scheduler *_scheduler;
+			clock_type::time_point _deadline;
+			bool await_ready() noexcept { return _deadline <= clock_type::now(); }
+			void await_suspend(std::coroutine_handle<> handle) { _scheduler->add_timer(_deadline, handle); }
+			void await_resume() noexcept {}
+		};
+
+	private:
+		// 在内部epoll中注册awaiter等待的事件
+		void watch(io_awaiter *awaiter);
+		// 添加一个定时器，若其为最早到期的定时器，则重新设置内部定时器
+		void add_timer(clock_type::time_point deadline, std::coroutine_handle<> handle);
+		// 恢复所有已到期的定时器所对应的协程
+		void expire_timers();
+		// 设置内部定时器的到期时间，需在持有锁的情况下调用
+		void arm_timer();
+		// 以不阻塞的方式将就绪队列中的协程交给线程池，线程池队列已满时设置重试定时器
+		void dispatch();
+		// 交给线程池执行的任务，恢复协程并在其挂起或结束后更新计数
+		void resume(std::coroutine_handle<> handle);
+
+	public:
+		// 构造函数，lane为恢复协程时使用的线程池任务车道
+		explicit io_scheduler(pool_type *pool, int lane = 0);
+		// 析构函数，先将就绪队列中的协程交给线程池，并等待线程池中的协程全部执行完毕
+		// 因此调度器可先于线程池析构，但仍在等待I/O或定时器的协程不会被恢复
+		~io_scheduler();
+		io_scheduler(const io_scheduler &rhs) = delete;
+		io_scheduler& operator=(const io_scheduler &rhs) = delete;
+
+		// 获取内部epoll对象的文件描述符，用于注册到主线程的epoll内核事件表中
+		int fd() const { return _epollfd; }
+		// 由主线程在检测到fd()可读时调用，将就绪的协程交给线程池恢复执行
+		void poll();
+		// 将协程放入就绪队列并唤醒主线程，由主线程交给线程池恢复执行，不会阻塞调用者
+		void post(std::coroutine_handle<> handle);
+		// 取消文件描述符在内部epoll中的注册，关闭文件描述符前需调用
+		void forget(int fd);
+
+		// co_await schedule()：将当前协程切换到线程池中执行
+		schedule_awaiter schedule() { return schedule_awaiter{this}; }
+		// co_await readable(fd)/writable(fd)：挂起当前协程直到文件描述符可读/可写
+		io_awaiter readable(int fd);
+		io_awaiter writable(int fd);
+		// co_await sleep_for(duration)：挂起当前协程一段时间
+		sleep_awaiter sleep_for(std::chrono::milliseconds duration) { return sleep_awaiter{this, clock_type::now() + duration}; }
+};
+
+#endif
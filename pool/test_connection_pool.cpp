@@ -9,6 +9,9 @@ int main() {
 	a->init("localhost", "root", 3306, "$Li&&990503", "web_server", 8);
 	/* a->init("localhost", "root", 3306, "$Li&&990503", "web_server", -8); */
 	auto conn = a->get_connection();
+	// 预处理语句在首次获取时创建，之后复用同一句柄
+	auto stmt = a->get_statement(conn, SQL_STATEMENT::SELECT_USER);
+	std::cout << (stmt != nullptr && stmt == a->get_statement(conn, SQL_STATEMENT::SELECT_USER) ? "cached" : "not cached") << std::endl;
 	/* std::this_thread::sleep_for(std::chrono::seconds(3)); */
 	a->put_connection(conn);
 	a->put_connection(nullptr);
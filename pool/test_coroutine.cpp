@@ -0,0 +1,89 @@
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include "coroutine.h"
+
+std::atomic<int> sleepers = 0;
+std::atomic<int> lingerers = 0;
+std::atomic<bool> stop = false;
+
+task<int> add(int a, int b) { co_return a + b; }
+
+// 嵌套等待有返回值的任务
+task<void> nested() {
+	int sum = co_await add(1, 2);
+	sum += co_await add(3, 4);
+	std::cout << "nested sum: " << sum << std::endl;
+}
+
+// 大量协程同时挂起在定时器上，只占用少量线程
+task<void> sleeper(io_scheduler *scheduler) {
+	co_await scheduler->schedule();
+	co_await scheduler->sleep_for(std::chrono::milliseconds(100));
+	++sleepers;
+}
+
+// 挂起直到套接字可读
+task<void> reader(io_scheduler *scheduler, int fd) {
+	co_await scheduler->readable(fd);
+	char buf[32] = {0};
+	recv(fd, buf, sizeof(buf) - 1, 0);
+	std::cout << "reader received: " << buf << std::endl;
+}
+
+// 调度器析构时仍在线程池中执行的协程，结束前再次访问调度器
+task<void> lingerer(io_scheduler *scheduler) {
+	co_await scheduler->schedule();
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	co_await scheduler->schedule();
+	++lingerers;
+}
+
+int main() {
+	// 请求队列远小于同时到期的协程数，验证线程池拒绝任务时调度器稍后重试而不阻塞事件循环
+	// 线程池先于调度器构造，按自然的顺序析构：调度器先析构，并等待线程池中的协程执行完毕
+	thread_pool<void()> tpool(2, 64);
+	io_scheduler *scheduler = new io_scheduler(&tpool);
+
+	// 模拟主线程的事件循环，检测到调度器的文件描述符可读时调用poll
+	std::thread reactor([scheduler]() {
+		int epollfd = epoll_create(5);
+		epoll_event event;
+		event.data.fd = scheduler->fd();
+		event.events = EPOLLIN;
+		epoll_ctl(epollfd, EPOLL_CTL_ADD, scheduler->fd(), &event);
+		while (!stop) {
+			if (epoll_wait(epollfd, &event, 1, 10) > 0) scheduler->poll();
+		}
+		close(epollfd);
+	});
+
+	co_spawn(nested());
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < 10000; ++i) co_spawn(sleeper(scheduler));
+	while (sleepers < 10000) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	std::cout << "10000 sleepers done in " << std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now() - start).count() << " ms with 2 threads" << std::endl;
+
+	int fds[2];
+	socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+	co_spawn(reader(scheduler, fds[0]));
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	send(fds[1], "hello, world", 12, 0);
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+	// 主线程停止调用poll后，调度器析构时自行将就绪的协程交给线程池，并等待其执行完毕
+	for (int i = 0; i < 4; ++i) co_spawn(lingerer(scheduler));
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	stop = true;
+	reactor.join();
+	close(fds[0]); close(fds[1]);
+	delete scheduler;
+	std::cout << "lingerers finished before the scheduler was destroyed: " << lingerers << std::endl;
+	return 0;
+}
@@ -0,0 +1,72 @@
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cassert>
+#include "thread_pool.h"
+
+// 弹性模式测试：模拟登录高峰时所有工作线程都阻塞在数据库查询上，且之后不再有新任务到达
+// 此时没有任务出队，线程池仍需根据排队时间扩容；阻塞解除并空闲一段时间后缩容至下限
+
+const int min_threads = 2;
+const int max_threads = 8;
+const auto wait_threshold = std::chrono::milliseconds(5);
+const auto idle_timeout = std::chrono::milliseconds(200);
+
+std::atomic<bool> released = false;
+std::atomic<int> running = 0;
+std::atomic<int> finished = 0;
+
+// 模拟阻塞在数据库查询上的任务
+void blocking_task() {
+	++running;
+	while (!released) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	--running;
+	++finished;
+}
+
+// 等待条件成立，超时返回false
+template <typename Predicate>
+bool wait_until(Predicate predicate, std::chrono::milliseconds timeout) {
+	auto deadline = std::chrono::steady_clock::now() + timeout;
+	while (!predicate()) {
+		if (std::chrono::steady_clock::now() > deadline) return false;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return true;
+}
+
+int main() {
+	thread_pool<void()> *tpool = new thread_pool<void()>(min_threads, 1000);
+	tpool->set_elastic(min_threads, max_threads, wait_threshold, idle_timeout);
+
+	// 一次性提交超过线程数上限的阻塞任务，之后不再提交，先占满初始的工作线程
+	const int tasks = max_threads + 4;
+	for (int i = 0; i < tasks; ++i) tpool->add_task(blocking_task);
+	bool blocked = wait_until([]() { return running >= min_threads; }, std::chrono::milliseconds(1000));
+	assert(blocked);
+
+	// 所有工作线程均阻塞，排队的任务超过阈值后扩容，且一次补足至上限，而不是每个阈值只新增一个线程
+	auto start = std::chrono::steady_clock::now();
+	bool grown = wait_until([]() { return running == max_threads; }, std::chrono::milliseconds(1000));
+	assert(grown);
+	std::cout << "grew to " << tpool->thread_number() << " threads in "
+		<< std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count()
+		<< " ms, grow count: " << tpool->grow_count() << std::endl;
+	assert(tpool->grow_count() == static_cast<std::size_t>(max_threads - min_threads));
+	assert(tpool->thread_number() == static_cast<std::size_t>(max_threads));
+
+	// 阻塞解除后完成所有任务，空闲超时后缩容至下限
+	released = true;
+	bool drained = wait_until([]() { return finished == tasks; }, std::chrono::milliseconds(1000));
+	assert(drained);
+	bool shrunk = wait_until([tpool]() { return tpool->thread_number() == static_cast<std::size_t>(min_threads); },
+			std::chrono::milliseconds(2000));
+	assert(shrunk);
+	std::cout << "shrank to " << tpool->thread_number() << " threads, shrink count: " << tpool->shrink_count() << std::endl;
+	assert(tpool->shrink_count() == static_cast<std::size_t>(max_threads - min_threads));
+
+	// 析构时等待所有工作线程和监视线程退出
+	delete tpool;
+	return 0;
+}
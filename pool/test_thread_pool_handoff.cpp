@@ -0,0 +1,56 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "thread_pool.h"
+
+// 任务交接延迟的基准测试：统计任务从add_task到开始执行的时间
+// 分别在不同的提交间隔（负载）下，比较直接挂起与先自旋再挂起两种等待策略
+
+typedef std::chrono::steady_clock clock_type;
+
+const int thread_number = 4;
+const int task_number = 20000;
+
+// 忙等一段时间，用于模拟主线程两次提交任务之间的事件处理
+void busy_for(std::chrono::microseconds interval) {
+	auto end = clock_type::now() + interval;
+	while (clock_type::now() < end) ;
+}
+
+void run(std::chrono::microseconds interval, int max_spin) {
+	thread_pool<void()> tpool(thread_number, 100000);
+	tpool.set_spin(max_spin);
+	// 等待工作线程全部进入空闲状态
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+	std::vector<double> latency(task_number);
+	std::atomic<int> done = 0;
+	for (int i = 0; i < task_number; ++i) {
+		auto start = clock_type::now();
+		tpool.add_task([&latency, &done, i, start]() {
+			latency[i] = std::chrono::duration<double, std::micro>(clock_type::now() - start).count();
+			++done;
+		});
+		busy_for(interval);
+	}
+	while (done < task_number) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+	std::sort(latency.begin(), latency.end());
+	std::cout << std::left << std::setw(14) << interval.count() << std::setw(10) << max_spin
+		<< std::fixed << std::setprecision(2)
+		<< " p50: " << std::setw(10) << latency[task_number / 2]
+		<< " p99: " << std::setw(10) << latency[task_number * 99 / 100] << " (us)" << std::endl;
+}
+
+int main() {
+	std::cout << std::left << std::setw(14) << "interval(us)" << std::setw(10) << "max_spin" << std::endl;
+	for (int interval : {0, 1, 10, 100}) {
+		run(std::chrono::microseconds(interval), 0);
+		run(std::chrono::microseconds(interval), 4000);
+	}
+	return 0;
+}
@@ -0,0 +1,62 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "thread_pool.h"
+
+// 混合请求的基准测试：模拟静态资源请求（耗时很短）与登录/注册请求（阻塞于数据库查询）
+// 分别在单车道与双车道（静态车道权重更高，并保留工作线程）模式下，统计静态请求从入队到完成的延迟
+
+typedef std::chrono::steady_clock clock_type;
+
+const int thread_number = 8; // 两种模式下的线程总数相同
+const int reserved_static = 2; // 双车道模式下为静态车道保留的工作线程数，包含在线程总数之内
+const int static_requests = 20000;
+const int database_every = 4; // 每4个静态请求夹杂1个数据库请求
+const auto database_cost = std::chrono::milliseconds(5);
+const auto static_cost = std::chrono::microseconds(20);
+const auto submit_interval = std::chrono::microseconds(50);
+
+// 模拟CPU密集的短任务
+void busy_for(std::chrono::microseconds cost) {
+	auto end = clock_type::now() + cost;
+	while (clock_type::now() < end) ;
+}
+
+void run(const char *name, bool use_lanes) {
+	// 保留线程由set_lane额外创建，因此双车道模式下普通工作线程减去保留线程数，使两种模式的线程总数一致
+	thread_pool<void()> tpool(use_lanes ? thread_number - reserved_static : thread_number, 100000, use_lanes ? 2 : 1);
+	if (use_lanes) { tpool.set_lane(0, 4, reserved_static); tpool.set_lane(1, 1); }
+
+	std::vector<double> latency(static_requests);
+	std::atomic<int> done = 0;
+	int static_lane = 0, database_lane = use_lanes ? 1 : 0;
+
+	for (int i = 0; i < static_requests; ++i) {
+		if (i % database_every == 0)
+			tpool.add_task([]() { std::this_thread::sleep_for(database_cost); }, database_lane);
+		auto start = clock_type::now();
+		tpool.add_task([&latency, &done, i, start]() {
+			busy_for(static_cost);
+			latency[i] = std::chrono::duration<double, std::micro>(clock_type::now() - start).count();
+			++done;
+		}, static_lane);
+		std::this_thread::sleep_for(submit_interval);
+	}
+	while (done < static_requests) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+	std::sort(latency.begin(), latency.end());
+	std::cout << std::left << std::setw(12) << name << std::fixed << std::setprecision(1)
+		<< " p50: " << std::setw(10) << latency[static_requests / 2]
+		<< " p99: " << std::setw(10) << latency[static_requests * 99 / 100]
+		<< " max: " << latency.back() << " (us)" << std::endl;
+}
+
+int main() {
+	run("single lane", false);
+	run("two lanes", true);
+	return 0;
+}
@@ -2,17 +2,31 @@
 #define THREAD_POOL_H
 
 #include <functional>
+#include <algorithm>
 #include <queue>
 #include <list>
+#include <vector>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
+#include <chrono>
 #include <stdexcept>
+#include "affinity.h"
 
 #ifndef NDEBUG
 #include <iostream>
 #endif
 
+// 自旋等待时提示CPU当前处于忙等状态，降低功耗并将流水线资源让给同核的超线程
+inline void _cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	asm volatile("yield");
+#endif
+}
+
 typedef bool _thread_pool_status_type;
 const _thread_pool_status_type _pool_startup = true;
 const _thread_pool_status_type _pool_shutdown = false;
@@ -24,61 +38,154 @@ class thread_pool {
 		typedef _thread_pool_status_type pool_status_type;
 		// 任务类型为仿函数对象（回调函数）
 		typedef std::function<Callback> task_type;
+		// 用于统计任务排队时间的时钟类型
+		typedef std::chrono::steady_clock clock_type;
+		// 请求队列中的元素，除任务本身外还记录任务的入队时间
+		struct task_entry {
+			task_type task;
+			clock_type::time_point enqueue_time;
+		};
 		// 请求队列类型，以双向链表为底层容器的队列，每个元素均表示一个任务
-		typedef std::queue<task_type, std::list<task_type>> task_queue_type;
+		typedef std::queue<task_entry, std::list<task_entry>> task_queue_type;
+		// 任务车道，每个车道拥有独立的请求队列，工作线程按权重在各车道之间轮询出队
+		// 以免廉价的静态资源请求排在阻塞于数据库查询的登录/注册请求之后
+		struct task_lane {
+			task_queue_type queue; // 该车道的请求队列
+			std::size_t weight; // 每一轮允许出队的任务数（权重）
+			std::size_t credit; // 本轮剩余可出队的任务数
+			std::size_t reserved; // 只为该车道服务的保留线程数
+			std::size_t parked; // 挂起在该车道条件变量上的保留线程数
+			std::condition_variable cond; // 保留线程等待该车道任务的条件变量
+		};
+		// 车道列表类型，车道数在构造时确定，之后不再改变
+		typedef std::vector<task_lane> lane_list_type;
+		// 表示工作线程不属于任何车道（可处理所有车道的任务）
+		static const std::size_t any_lane = static_cast<std::size_t>(-1);
 
 		// 线程池状态（打开/关闭）
 		pool_status_type _pool_status;
-		// 线程池中线程数量
-		std::size_t _thread_number;
+		// 线程池中当前存活的线程数量（包括各车道的保留线程）
+		std::atomic<std::size_t> _thread_number;
+		// 各车道保留线程数之和，保留线程不参与弹性伸缩
+		std::size_t _reserved_threads;
+		// 弹性模式下线程数量的上下限，非弹性模式下二者均等于初始线程数
+		std::size_t _min_threads;
+		std::size_t _max_threads;
+		// 是否开启弹性模式
+		bool _elastic;
+		// 任务排队时间超过该阈值则扩容
+		std::chrono::microseconds _wait_threshold;
+		// 工作线程空闲超过该时间则退出（缩容）
+		std::chrono::milliseconds _idle_timeout;
+		// 因扩容而创建、但尚未开始拉取任务的工作线程数，避免在新线程启动前重复扩容
+		std::size_t _starting;
+		// 弹性模式下的监视线程是否存活，监视线程每隔一个排队时间阈值检查一次是否需要扩容
+		bool _monitor;
 		// 请求队列允许的最大请求数
 		std::size_t _max_requests;
-		// 指向请求队列的指针，队列中元素即工作线程需要竞争的共享资源
-		task_queue_type *_task_queue;
+		// 指向车道列表的指针，各车道请求队列中的元素即工作线程需要竞争的共享资源
+		lane_list_type *_lanes;
+		// 所有车道中的任务总数，自旋等待的工作线程会在不加锁的情况下读取，因此使用原子变量
+		std::atomic<std::size_t> _task_count;
+		// 加权轮询的当前车道
+		std::size_t _cursor;
 		// 保护请求队列的互斥锁
 		std::mutex _mutex;
 		// 用于生产者/消费者（工作线程）模型的条件变量，需要搭配互斥锁一起使用
 		std::condition_variable _cond_producer;
 		std::condition_variable _cond_consumer;
+		// 用于析构时等待所有工作线程和监视线程退出的条件变量
+		std::condition_variable _cond_exit;
+		// 用于定时唤醒监视线程的条件变量，析构时用于通知其退出
+		std::condition_variable _cond_monitor;
+		// 挂起在条件变量上的普通工作线程数和生产者线程数，只有存在挂起的线程时才需要唤醒
+		// 从而避免在中等负载下每添加/取出一个任务都执行一次futex系统调用
+		std::size_t _parked_workers;
+		std::size_t _parked_producers;
+		// 工作线程挂起前自旋等待新任务的最大次数，为0表示不自旋
+		std::size_t _max_spin;
+		// 当前的自旋次数，根据自旋是否等到任务在[_max_spin/16, _max_spin]之间自适应调整
+		std::atomic<std::size_t> _spin_limit;
+		// 请求队列已满导致任务被拒绝的次数
+		std::atomic<std::size_t> _full_count;
+		// 扩容/缩容的次数
+		std::atomic<std::size_t> _grow_count;
+		std::atomic<std::size_t> _shrink_count;
 
 	private:
-		// 工作线程从请求队列中拉取任务进行处理
-		void worker();
+		// 工作线程从请求队列中拉取任务进行处理，lane为保留线程所属的车道，grown表示是否为扩容创建的线程
+		void worker(std::size_t lane, bool grown);
+		// 创建一个工作线程，并将工作线程与主线程分离
+		void spawn_worker(std::size_t lane = any_lane);
+		// 弹性模式下的监视线程，即使所有工作线程都阻塞且没有新任务到达，也能发现排队过久的任务并扩容
+		void monitor();
+		// 向指定车道的请求队列中添加任务并唤醒工作线程，需在持有锁的情况下调用
+		void push_task(task_type &&task, std::size_t lane, std::unique_lock<std::mutex> &lock);
+		// 选出下一个出队任务所在的车道，需在持有锁的情况下调用，若无任务可取则返回any_lane
+		std::size_t select_lane(std::size_t lane);
+		// 根据最早入队任务的排队时间计算需要新增的工作线程数，并预先计入存活线程数，需在持有锁的情况下调用
+		std::size_t need_grow(clock_type::time_point now);
+		// 创建need_grow计算出的number个工作线程，需在释放锁之后调用
+		void grow(std::size_t number);
+		// 挂起前先释放锁自旋等待新任务，返回是否等到了任务，调用前后均持有锁
+		bool spin_wait(std::unique_lock<std::mutex> &lock);
 
 	public:
-		// 构造函数
-		thread_pool(int thread_number, int max_requests);
+		// 构造函数，lane_number为任务车道数，默认所有任务共用一个车道
+		thread_pool(int thread_number, int max_requests, int lane_number = 1);
 
 		// 析构函数
 		~thread_pool();
 
-		// 向请求队列中添加任务
-		void add_task(task_type &&task);
+		// 向指定车道的请求队列中添加任务
+		void add_task(task_type &&task, int lane = 0);
+		// 尝试向请求队列中添加任务，若队列已满则立即返回false，不阻塞调用者
+		bool try_add_task(task_type &&task, int lane = 0);
+
+		// 设置车道的权重，并为该车道创建reserved个只处理该车道任务的保留线程
+		void set_lane(int lane, int weight, int reserved = 0);
+
+		// 设置工作线程挂起前自旋等待的最大次数，为0（默认）表示无任务时直接挂起
+		void set_spin(int max_spin);
+
+		// 开启弹性模式，线程数在[min_threads, max_threads]之间根据任务排队时间自动伸缩
+		void set_elastic(int min_threads, int max_threads,
+				std::chrono::microseconds wait_threshold, std::chrono::milliseconds idle_timeout);
+
+		// 获取因请求队列已满而被拒绝的任务数
+		std::size_t full_count() const { return _full_count.load(std::memory_order_relaxed); }
+		// 获取线程池当前的线程数量以及扩容/缩容的次数
+		std::size_t thread_number() const { return _thread_number.load(std::memory_order_relaxed); }
+		std::size_t grow_count() const { return _grow_count.load(std::memory_order_relaxed); }
+		std::size_t shrink_count() const { return _shrink_count.load(std::memory_order_relaxed); }
 };
 
 // 构造函数，初始化线程池信息，并创建工作线程
 template <typename Callback>
-thread_pool<Callback>::thread_pool(int thread_number, int max_requests) : _pool_status(_pool_startup) {
+thread_pool<Callback>::thread_pool(int thread_number, int max_requests, int lane_number) : _pool_status(_pool_startup),
+	_thread_number(0), _reserved_threads(0), _elastic(false), _starting(0), _monitor(false), _task_count(0), _cursor(0),
+	_parked_workers(0), _parked_producers(0), _max_spin(0), _spin_limit(0),
+	_full_count(0), _grow_count(0), _shrink_count(0) {
 #ifndef NDEBUG
 		std::cout << "\ninitialize thread pool..." << std::endl;
 #endif
 	// 判断线程数和最大请求数是否合法
-	if (thread_number <= 0 || max_requests <= 0)
-		throw std::runtime_error("invalid number of threads or requests");
-	// 分配请求队列，默认初始化为空队列
-	if (!(_task_queue = new task_queue_type()))
+	if (thread_number <= 0 || max_requests <= 0 || lane_number <= 0)
+		throw std::runtime_error("invalid number of threads, requests or lanes");
+	// 分配各车道的请求队列，默认初始化为空队列，且各车道权重均为1
+	if (!(_lanes = new lane_list_type(static_cast<std::size_t>(lane_number))))
 		throw std::runtime_error("failed to allocate memory for task queue");
+	for (task_lane &l : *_lanes) { l.weight = l.credit = 1; l.reserved = l.parked = 0; }
 
-	_thread_number = static_cast<std::size_t>(thread_number);
+	_min_threads = _max_threads = static_cast<std::size_t>(thread_number);
 	_max_requests = static_cast<std::size_t>(max_requests);
 
 	// 创建工作线程，并将工作线程与主线程分离
-	for (std::size_t i = 0; i < _thread_number; ++i) {
+	for (std::size_t i = 0; i < _min_threads; ++i) {
 #ifndef NDEBUG
 		std::cout << "** create the " << i << "-th thread" << std::endl;
 #endif
-		// 使用成员函数作为工作线程的回调函数需额外传递this指针
-		std::thread(&thread_pool::worker, this).detach();
+		spawn_worker();
 	}
 #ifndef NDEBUG
 	std::cout << "** " << (_pool_status ? "(startup)" : "(shutdown)")
@@ -92,11 +199,18 @@ thread_pool<Callback>::~thread_pool() {
 #ifndef NDEBUG
 	std::cout << "\ndestroy thread pool..." << std::endl;
 #endif
-	_pool_status = _pool_shutdown; delete _task_queue;
+	std::unique_lock<std::mutex> lock(_mutex);
+	_pool_status = _pool_shutdown;
 	_cond_producer.notify_all();
 	// 唤醒所有阻塞的工作线程，由于此时线程池变成了关闭状态
 	// 那么worker中的循环判断就不成立，因此工作线程退出
 	_cond_consumer.notify_all();
+	for (task_lane &l : *_lanes) l.cond.notify_all();
+	_cond_monitor.notify_all();
+	// 工作线程与主线程分离，且在弹性模式下会自行退出，因此无法join
+	// 只能等待存活线程数归零且监视线程退出后再释放请求队列，避免其访问已释放的资源
+	_cond_exit.wait(lock, [this]() { return _thread_number == 0 && !_monitor; });
+	delete _lanes;
 #ifndef NDEBUG
 	std::cout << "** " << (_pool_status ? "(startup)" : "(shutdown)")
 		<< " thread pool size => 0" << std::endl;
@@ -106,7 +220,9 @@ thread_pool<Callback>::~thread_pool() {
 // 向请求队列中添加任务，右值引用用于模板转发实参
 // 函数形参为指向模板类型参数的右值引用，可保持实参的所有类型信息
 template <typename Callback>
-void thread_pool<Callback>::add_task(task_type &&task) {
+void thread_pool<Callback>::add_task(task_type &&task, int lane) {
+	if (lane < 0 || static_cast<std::size_t>(lane) >= _lanes->size())
+		throw std::runtime_error("invalid lane of task");
 	// 向请求队列中添加任务，需要对请求队列进行锁保护
 	std::unique_lock<std::mutex> lock(_mutex);
 #ifndef NDEBUG
@@ -114,13 +230,15 @@ void thread_pool<Callback>::add_task(task_type &&task) {
 #endif
 	// 若请求队列中的任务数超出最大请求数上限，应该延迟添加，而不应该拒绝请求
 	// 即阻塞生产者线程，等待工作线程取出任务为请求队列腾出空间以添加新任务
-	while (_task_queue->size() >= _max_requests) {
+	while (_task_count >= _max_requests) {
 #ifndef NDEBUG
-		std::cout << "** (wait) task queue size => " << _task_queue->size() << std::endl;
+		std::cout << "** (wait) task queue size => " << _task_count << std::endl;
 #endif
 		// 若生产者线程此时处于加锁状态，则自动解锁，但不解除阻塞
 		// 若生产者线程解除阻塞，则再次加锁，以执行临界区（while循环后面的代码）
+		++_parked_producers;
 		_cond_producer.wait(lock);
+		--_parked_producers;
 	}
 	// 向请求队列中添加新任务，forward用于保持实参类型信息
 	// emplace在队列尾部调用task的构造函数来添加一个任务，效率更高
@@ -130,26 +248,234 @@ void thread_pool<Callback>::add_task(task_type &&task) {
 	// 移动操作的存在条件：
 	// 1. 自定义了移动构造和移动赋值，但此时编译器不会再默认合成拷贝操作
 	// 2. 未自定义拷贝操作、析构且对象所有成员可移动，则编译器默认合成
-	_task_queue->emplace(std::forward<task_type>(task));
+	push_task(std::forward<task_type>(task), static_cast<std::size_t>(lane), lock);
+}
+
+// 尝试向请求队列中添加任务，与add_task不同，队列已满时不会阻塞生产者线程
+// 主线程（反应堆）是唯一的生产者，若被阻塞则所有连接都无法得到服务
+// 因此由调用者根据返回值决定如何处理被拒绝的请求（如直接返回503）
+template <typename Callback>
+bool thread_pool<Callback>::try_add_task(task_type &&task, int lane) {
+	if (lane < 0 || static_cast<std::size_t>(lane) >= _lanes->size())
+		throw std::runtime_error("invalid lane of task");
+	std::unique_lock<std::mutex> lock(_mutex);
+	if (_task_count >= _max_requests) {
+#ifndef NDEBUG
+		std::cout << "\n** (full) task queue size => " << _task_count << std::endl;
+#endif
+		_full_count.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	push_task(std::forward<task_type>(task), static_cast<std::size_t>(lane), lock);
+	return true;
+}
+
+// 向指定车道的请求队列中添加任务，并唤醒工作线程
+template <typename Callback>
+void thread_pool<Callback>::push_task(task_type &&task, std::size_t lane, std::unique_lock<std::mutex> &lock) {
+	task_lane &l = (*_lanes)[lane];
+	l.queue.emplace(task_entry{std::forward<task_type>(task), clock_type::now()});
+	++_task_count;
+	bool wake_worker = _parked_workers > 0, wake_reserved = l.parked > 0;
+	// 在生产者一侧检查排队时间，工作线程全部阻塞（如都在等待数据库）时不会有任务出队，出队时检查将无法扩容
+	std::size_t growth = need_grow(l.queue.back().enqueue_time);
 #ifndef NDEBUG
-	std::cout << "** (done) task queue size => " << _task_queue->size() << std::endl;
+	std::cout << "** (done) task queue size => " << _task_count << std::endl;
 #endif
 	// 解锁并唤醒阻塞在条件变量上的一个工作线程，让其处理任务
+	// 若该车道有挂起的保留线程，则同时唤醒一个保留线程，由先拿到锁的线程处理该任务
+	// 若没有挂起的线程，则正在自旋的工作线程会自行发现新任务，无需执行唤醒的系统调用
 	lock.unlock();
-	_cond_consumer.notify_one();
+	if (wake_worker) _cond_consumer.notify_one();
+	if (wake_reserved) l.cond.notify_one();
+	grow(growth);
+}
+
+// 设置工作线程挂起前自旋等待的最大次数
+// 中等负载下，任务往往在工作线程刚变为空闲后很快到达，此时短暂自旋即可取到任务
+// 省去了挂起和唤醒线程所需的futex系统调用及上下文切换，但自旋会占用CPU
+// 因此自旋次数会根据最近的自旋是否等到任务自适应调整
+template <typename Callback>
+void thread_pool<Callback>::set_spin(int max_spin) {
+	if (max_spin < 0) throw std::runtime_error("invalid number of max_spin");
+	std::lock_guard<std::mutex> lock(_mutex);
+	_max_spin = static_cast<std::size_t>(max_spin);
+	_spin_limit = _max_spin;
+}
+
+// 挂起前先释放锁自旋等待新任务，只读取原子变量_task_count，不与生产者竞争锁
+// 自旋期间等到了任务，则将自旋次数加倍，否则减半，上下限分别为_max_spin和_max_spin/16
+template <typename Callback>
+bool thread_pool<Callback>::spin_wait(std::unique_lock<std::mutex> &lock) {
+	std::size_t limit = _spin_limit.load(std::memory_order_relaxed);
+	if (limit == 0) return false;
+	lock.unlock();
+	bool found = false;
+	for (std::size_t i = 0; i < limit && !found; ++i) {
+		_cpu_relax();
+		found = _task_count.load(std::memory_order_relaxed) > 0;
+	}
+	lock.lock();
+	std::size_t floor = _max_spin / 16 ? _max_spin / 16 : 1;
+	_spin_limit = found ? std::min(limit * 2, _max_spin) : std::max(limit / 2, floor);
+	return found;
+}
+
+// 设置车道的权重，并为该车道创建reserved个只处理该车道任务的保留线程
+// 权重表示每一轮加权轮询中该车道最多可连续出队的任务数，保留线程则保证该车道
+// 即使在其他车道的任务占满所有普通工作线程时，也始终有线程可以处理
+template <typename Callback>
+void thread_pool<Callback>::set_lane(int lane, int weight, int reserved) {
+	if (lane < 0 || static_cast<std::size_t>(lane) >= _lanes->size())
+		throw std::runtime_error("invalid lane of task");
+	if (weight <= 0 || reserved < 0)
+		throw std::runtime_error("invalid weight or reserved threads of lane");
+
+	std::unique_lock<std::mutex> lock(_mutex);
+	task_lane &l = (*_lanes)[lane];
+	l.weight = l.credit = static_cast<std::size_t>(weight);
+	l.reserved += static_cast<std::size_t>(reserved);
+	_reserved_threads += static_cast<std::size_t>(reserved);
+	lock.unlock();
+#ifndef NDEBUG
+	std::cout << "\nset lane " << lane << " of thread pool..." << std::endl;
+	std::cout << "** weight => " << weight << std::endl;
+	std::cout << "** reserved => " << l.reserved << std::endl;
+#endif
+	while (reserved--) spawn_worker(static_cast<std::size_t>(lane));
 }
 
-// 工作线程从请求队列中拉取任务进行处理
+// 按加权轮询选出下一个出队任务所在的车道
+// 普通工作线程从当前车道开始，依次寻找非空且本轮仍有额度的车道
+// 若所有非空车道的额度均已用完，则开始新的一轮，将各车道额度重置为其权重
+// 保留线程只从所属车道取任务，且不消耗普通工作线程的轮询额度
 template <typename Callback>
-void thread_pool<Callback>::worker() {
+std::size_t thread_pool<Callback>::select_lane(std::size_t lane) {
+	if (lane != any_lane) return (*_lanes)[lane].queue.empty() ? any_lane : lane;
+	if (_task_count == 0) return any_lane;
+
+	std::size_t n = _lanes->size();
+	for (int round = 0; round < 2; ++round) {
+		for (std::size_t i = 0; i < n; ++i) {
+			std::size_t k = (_cursor + i) % n;
+			task_lane &l = (*_lanes)[k];
+			if (l.queue.empty() || l.credit == 0) continue;
+			// 当前车道额度用完后，下次从下一个车道开始轮询
+			_cursor = (--l.credit == 0 ? k + 1 : k) % n;
+			return k;
+		}
+		// 所有非空车道的额度均已用完，开始新的一轮
+		for (task_lane &l : *_lanes) l.credit = l.weight;
+	}
+	return any_lane;
+}
+
+// 开启弹性模式，线程数在[min_threads, max_threads]之间根据任务排队时间自动伸缩
+// 当最早入队的任务排队时间超过wait_threshold，说明工作线程不足（如都阻塞在数据库查询上），则扩容，
+// 由添加任务的生产者和每隔wait_threshold检查一次的监视线程负责判断，而不依赖工作线程出队
+// 当工作线程空闲时间超过idle_timeout，且线程数大于下限，则该工作线程退出
+template <typename Callback>
+void thread_pool<Callback>::set_elastic(int min_threads, int max_threads,
+		std::chrono::microseconds wait_threshold, std::chrono::milliseconds idle_timeout) {
+	if (min_threads <= 0 || max_threads < min_threads)
+		throw std::runtime_error("invalid number of min_threads or max_threads");
+	if (wait_threshold.count() <= 0 || idle_timeout.count() <= 0)
+		throw std::runtime_error("invalid wait_threshold or idle_timeout");
+
+	std::unique_lock<std::mutex> lock(_mutex);
+	_min_threads = static_cast<std::size_t>(min_threads);
+	_max_threads = static_cast<std::size_t>(max_threads);
+	_wait_threshold = wait_threshold;
+	_idle_timeout = idle_timeout;
+	_elastic = true;
+	bool start_monitor = !_monitor;
+	_monitor = true;
+	// 若当前普通工作线程数小于下限，则补齐至下限
+	std::size_t general = _thread_number - _reserved_threads;
+	std::size_t lack = general < _min_threads ? _min_threads - general : 0;
+	lock.unlock();
+#ifndef NDEBUG
+	std::cout << "\nset elastic thread pool..." << std::endl;
+	std::cout << "** min_threads => " << _min_threads << std::endl;
+	std::cout << "** max_threads => " << _max_threads << std::endl;
+#endif
+	while (lack--) spawn_worker();
+	if (start_monitor) std::thread(&thread_pool::monitor, this).detach();
+}
+
+// 创建一个工作线程，并将工作线程与主线程分离
+template <typename Callback>
+void thread_pool<Callback>::spawn_worker(std::size_t lane) {
+	// 先增加存活线程数，确保析构函数能够等待该线程退出
+	++_thread_number;
+	// 使用成员函数作为工作线程的回调函数需额外传递this指针
+	std::thread(&thread_pool::worker, this, lane, false).detach();
+}
+
+// 根据最早入队任务的排队时间计算需要新增的工作线程数，需在持有锁的情况下调用
+// 有挂起的普通工作线程时，唤醒即可处理任务，无需扩容；否则为每个尚无线程处理的排队任务新增一个线程，
+// 不超过线程数上限，所有工作线程都阻塞时可一次补足，而不是每个排队时间阈值只新增一个线程
+// 新增的线程预先计入存活线程数和启动中的线程数，避免在新线程开始拉取任务之前重复扩容
+template <typename Callback>
+std::size_t thread_pool<Callback>::need_grow(clock_type::time_point now) {
+	if (!_elastic || _parked_workers > 0 || _task_count <= _starting) return 0;
+	std::size_t general = _thread_number - _reserved_threads;
+	if (general >= _max_threads) return 0;
+	bool stale = false;
+	for (const task_lane &l : *_lanes)
+		if (!l.queue.empty() && now - l.queue.front().enqueue_time >= _wait_threshold) { stale = true; break; }
+	if (!stale) return 0;
+	std::size_t number = std::min(_task_count - _starting, _max_threads - general);
+	_thread_number += number;
+	_starting += number;
+	_grow_count += number;
+	return number;
+}
+
+// 创建need_grow计算出的工作线程，存活线程数已在need_grow中增加
+template <typename Callback>
+void thread_pool<Callback>::grow(std::size_t number) {
+#ifndef NDEBUG
+	if (number) std::cout << "** (grow) thread pool size => " << _thread_number << std::endl;
+#endif
+	while (number--) std::thread(&thread_pool::worker, this, any_lane, true).detach();
+}
+
+// 监视线程每隔一个排队时间阈值检查一次最早入队任务的排队时间
+template <typename Callback>
+void thread_pool<Callback>::monitor() {
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (_pool_status != _pool_shutdown) {
+		_cond_monitor.wait_for(lock, _wait_threshold);
+		if (_pool_status == _pool_shutdown) break;
+		std::size_t growth = need_grow(clock_type::now());
+		if (!growth) continue;
+		lock.unlock();
+		grow(growth);
+		lock.lock();
+	}
+	// 监视线程退出，唤醒可能在等待的析构函数
+	_monitor = false;
+	_cond_exit.notify_all();
+}
+
+// 工作线程从请求队列中拉取任务进行处理，保留线程只处理所属车道的任务
+template <typename Callback>
+void thread_pool<Callback>::worker(std::size_t lane, bool grown) {
+	// 按放置策略绑定CPU，若未初始化CPU亲和性则不绑定
+	cpu_affinity::get_instance()->bind_current_thread();
 	// 从请求队列中拉取任务，需要对请求队列进行锁保护
 	std::unique_lock<std::mutex> lock(_mutex);
+	// 扩容创建的线程已开始拉取任务
+	if (grown) --_starting;
 	// 先判断线程池状态，若为开启则一直进行事件循环
 	while (_pool_status != _pool_shutdown) {
+		std::size_t k = select_lane(lane);
 		// 队列中有任务，工作线程拉取并处理
-		if (!_task_queue->empty()) {
+		if (k != any_lane) {
+			task_queue_type &queue = (*_lanes)[k].queue;
 			// 这两种方式可以通过编译，运行也不会报错
-			task_type task = _task_queue->front();
+			task_type task = queue.front().task;
 			/* auto task = std::move(_task_queue->front()); */
 
 			// 以下两种方式可以通过编译，但是运行会报错--std::bad_function_call
@@ -161,10 +487,11 @@ void thread_pool<Callback>::worker() {
 #ifndef NDEBUG
 			std::cout << "\nprocess task => " << &task << "..." << std::endl;
 #endif
-			_task_queue->pop();
+			queue.pop(); --_task_count;
+			bool wake_producer = _parked_producers > 0;
 			// 取出任务就解锁，并唤醒可能阻塞的生产者线程
 			lock.unlock();
-			_cond_producer.notify_one();
+			if (wake_producer) _cond_producer.notify_one();
 			// 工作线程执行任务
 			task();
 #ifndef NDEBUG
@@ -183,9 +510,32 @@ void thread_pool<Callback>::worker() {
 #endif
 			// 若工作线程此时处于加锁状态，则自动解锁，但不解除阻塞
 			// 若工作线程解除阻塞，则再次加锁，以执行临界区（下一次循环）
-			_cond_consumer.wait(lock);
+			// 保留线程只等待所属车道的任务，且不参与弹性伸缩和自旋
+			if (lane != any_lane) {
+				task_lane &l = (*_lanes)[lane];
+				++l.parked; l.cond.wait(lock); --l.parked;
+				continue;
+			}
+			// 普通工作线程先自旋等待一段时间，若期间有新任务到达则无需挂起
+			if (spin_wait(lock)) continue;
+			// 自旋期间释放了锁，挂起前需再次检查任务和线程池状态，以免错过唤醒
+			if (_task_count > 0 || _pool_status == _pool_shutdown) continue;
+			++_parked_workers;
+			if (!_elastic) { _cond_consumer.wait(lock); --_parked_workers; continue; }
+			// 弹性模式下，若空闲超时且普通工作线程数大于下限，则工作线程退出
+			bool idle = _cond_consumer.wait_for(lock, _idle_timeout) == std::cv_status::timeout;
+			--_parked_workers;
+			if (idle && _task_count == 0 && _thread_number - _reserved_threads > _min_threads) {
+#ifndef NDEBUG
+				std::cout << "** (shrink) thread pool size => " << _thread_number - 1 << std::endl;
+#endif
+				++_shrink_count;
+				break;
+			}
 		}
 	}
+	// 工作线程退出，若存活线程数归零，则唤醒可能在等待的析构函数
+	if (--_thread_number == 0) _cond_exit.notify_all();
 }
 
 #endif
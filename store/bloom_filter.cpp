@@ -0,0 +1,85 @@
+#include <functional>
+#include "bloom_filter.h"
+
+// 块数向上取整为2的幂，至少为1
+bloom_filter::layer::layer(std::size_t cap, std::size_t bits_per_key) : capacity(cap) {
+	std::size_t blocks = 1;
+	while (blocks * block_words * 64 < capacity * bits_per_key) blocks <<= 1;
+	block_mask = blocks - 1;
+	words.reset(new std::atomic<std::uint64_t>[blocks * block_words]);
+	for (std::size_t i = 0; i < blocks * block_words; ++i) words[i].store(0, std::memory_order_relaxed);
+}
+
+bloom_filter::bloom_filter(std::size_t expected, std::size_t bits_per_key)
+	: _bits_per_key(bits_per_key > 0 ? bits_per_key : 10), _layer_count(1) {
+	_layers[0].store(new layer(expected > 0 ? expected : 1, _bits_per_key), std::memory_order_relaxed);
+	for (std::size_t i = 1; i < max_layers; ++i) _layers[i].store(nullptr, std::memory_order_relaxed);
+}
+
+bloom_filter::~bloom_filter() {
+	for (std::size_t i = 0; i < max_layers; ++i) delete _layers[i].load(std::memory_order_relaxed);
+}
+
+void bloom_filter::reserve(std::size_t expected) {
+	if (size() != 0 || expected <= _layers[0].load(std::memory_order_relaxed)->capacity) return;
+	delete _layers[0].exchange(new layer(expected, _bits_per_key), std::memory_order_acq_rel);
+}
+
+std::uint64_t bloom_filter::hash(std::string_view name) {
+	return std::hash<std::string_view>{}(name);
+}
+
+// 将哈希值乘以黄金分割常数混合一次，用其高位选择块，使块的选择与块内位的选择相互独立
+std::atomic<std::uint64_t>* bloom_filter::block_of(const layer *l, std::uint64_t h) {
+	return &l->words[(((h * 0x9e3779b97f4a7c15ULL) >> 20) & l->block_mask) * block_words];
+}
+
+// 块内第i个字中的位由哈希值的第6i到6i+5位选择
+bool bloom_filter::test(const layer *l, std::uint64_t h) {
+	const std::atomic<std::uint64_t> *words = block_of(l, h);
+	for (std::size_t i = 0; i < block_words; ++i)
+		if (!(words[i].load(std::memory_order_acquire) & (std::uint64_t(1) << ((h >> (6 * i)) & 63)))) return false;
+	return true;
+}
+
+bool bloom_filter::may_contain(std::string_view name) const {
+	std::uint64_t h = hash(name);
+	std::size_t count = _layer_count.load(std::memory_order_acquire);
+	// 从最新的层开始检查，刚注册的用户名更可能被再次访问
+	for (std::size_t i = count; i-- > 0; )
+		if (test(_layers[i].load(std::memory_order_acquire), h)) return true;
+	return false;
+}
+
+// 已可能存在的用户名不再加入，避免重复计数导致过早追加新层
+void bloom_filter::add(std::string_view name) {
+	std::uint64_t h = hash(name);
+	std::size_t count = _layer_count.load(std::memory_order_acquire);
+	for (std::size_t i = count; i-- > 0; )
+		if (test(_layers[i].load(std::memory_order_acquire), h)) return;
+
+	// 在最后一层占用一个名额，最后一层已满时撤销占用，追加一层容量翻倍的新层后重试
+	layer *l;
+	while (true) {
+		count = _layer_count.load(std::memory_order_acquire);
+		l = _layers[count - 1].load(std::memory_order_acquire);
+		if (l->count.fetch_add(1, std::memory_order_relaxed) < l->capacity || count == max_layers) break;
+		l->count.fetch_sub(1, std::memory_order_relaxed);
+		std::lock_guard<std::mutex> lock(_grow_mutex);
+		// 其他线程可能已经追加了新层
+		if (_layer_count.load(std::memory_order_relaxed) == count) {
+			_layers[count].store(new layer(l->capacity * 2, _bits_per_key), std::memory_order_release);
+			_layer_count.store(count + 1, std::memory_order_release);
+		}
+	}
+
+	std::atomic<std::uint64_t> *words = block_of(l, h);
+	for (std::size_t i = 0; i < block_words; ++i)
+		words[i].fetch_or(std::uint64_t(1) << ((h >> (6 * i)) & 63), std::memory_order_release);
+}
+
+std::size_t bloom_filter::size() const {
+	std::size_t total = 0, count = _layer_count.load(std::memory_order_acquire);
+	for (std::size_t i = 0; i < count; ++i) total += _layers[i].load(std::memory_order_acquire)->count.load(std::memory_order_relaxed);
+	return total;
+}
@@ -0,0 +1,62 @@
+#ifndef BLOOM_FILTER_H
+#define BLOOM_FILTER_H
+
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <string_view>
+#include <cstdint>
+
+// 用户名的布隆过滤器，用于快速判定用户名一定不存在，只有可能存在的用户名才需要查找凭据存储或数据库
+// 1. 采用分块布隆过滤器：每个用户名只映射到一个64字节的块（一个缓存行），在块的8个64位字中各置一位，
+//    判定时最多访问一个缓存行，每个用户名10位时误判率约为1%
+// 2. 置位采用原子的fetch_or，判定采用无锁的原子读取，多个工作线程可以同时注册和判定
+// 3. 随着用户注册增量扩展（可扩展布隆过滤器）：当前层的用户名数达到容量时追加一层容量翻倍的新层，
+//    新的用户名只加入最后一层，判定时依次检查所有层，已有的层无需重建
+class bloom_filter {
+	private:
+		// 最大层数，达到后不再追加新层，继续加入最后一层（误判率随之升高）
+		static const std::size_t max_layers = 16;
+		// 每个块包含的64位字数
+		static const std::size_t block_words = 8;
+
+		struct layer {
+			std::size_t capacity; // 层的容量（用户名数）
+			std::size_t block_mask; // 块数减1，块数为2的幂
+			std::unique_ptr<std::atomic<std::uint64_t>[]> words;
+			std::atomic<std::size_t> count{0}; // 已加入的用户名数
+			layer(std::size_t cap, std::size_t bits_per_key);
+		};
+
+		std::size_t _bits_per_key; // 每个用户名占用的位数
+		std::atomic<layer*> _layers[max_layers]; // 所有层，只追加不删除
+		std::atomic<std::size_t> _layer_count; // 已发布的层数
+		std::mutex _grow_mutex; // 追加新层时加锁
+
+	private:
+		static std::uint64_t hash(std::string_view name);
+		// 获取哈希值在层中对应的块
+		static std::atomic<std::uint64_t>* block_of(const layer *l, std::uint64_t h);
+		// 判断哈希值在层中对应的位是否均已置位
+		static bool test(const layer *l, std::uint64_t h);
+
+	public:
+		// expected为第一层的容量，bits_per_key为每个用户名占用的位数
+		explicit bloom_filter(std::size_t expected = 1 << 16, std::size_t bits_per_key = 10);
+		bloom_filter(const bloom_filter &rhs) = delete;
+		bloom_filter& operator=(const bloom_filter &rhs) = delete;
+		~bloom_filter();
+
+		// 按预计的用户名数重新分配第一层，避免加载大量用户名时追加过多的层，只能在启动阶段加入用户名之前调用
+		void reserve(std::size_t expected);
+		// 加入用户名，需在用户名对其他线程可见（写入凭据存储）之前调用
+		void add(std::string_view name);
+		// 判断用户名是否可能存在，返回false表示一定不存在
+		bool may_contain(std::string_view name) const;
+		// 获取已加入的用户名数，加入时被误判为已存在的用户名不计入，因此略小于实际数量
+		std::size_t size() const;
+		// 获取当前的层数
+		std::size_t layer_count() const { return _layer_count.load(std::memory_order_acquire); }
+};
+
+#endif
@@ -0,0 +1,136 @@
+#include <utility>
+#include "credential_cache.h"
+
+credential_cache::credential_cache(fetch_type fetch, std::size_t capacity,
+		std::chrono::seconds found_ttl, std::chrono::seconds not_found_ttl)
+	: _fetch(std::move(fetch)), _found_ttl(found_ttl), _not_found_ttl(not_found_ttl), _shards(new shard[shard_count]) {
+	for (std::size_t i = 0; i < shard_count; ++i) {
+		_shards[i].capacity = capacity / shard_count + (i < capacity % shard_count ? 1 : 0);
+		_shards[i].entries.reserve(_shards[i].capacity);
+	}
+}
+
+credential_cache::shard& credential_cache::shard_of(std::string_view name) const {
+	return _shards[std::hash<std::string_view>{}(name) % shard_count];
+}
+
+void credential_cache::fill(shard &s, std::string_view name, bool found, std::string_view password) {
+	clock_type::time_point now = clock_type::now();
+	clock_type::time_point expire = now + (found ? _found_ttl : _not_found_ttl);
+	auto it = s.index.find(name);
+	if (it != s.index.end()) {
+		entry &e = s.entries[it->second];
+		e.password.assign(password);
+		e.found = found;
+		e.referenced = true;
+		e.expire = expire;
+		return;
+	}
+	if (s.capacity == 0) return;
+	if (s.entries.size() < s.capacity) {
+		s.index.emplace(name, s.entries.size());
+		s.entries.push_back(entry{std::string(name), std::string(password), found, false, expire});
+		return;
+	}
+	// 每经过一项清除其访问标记，最多转两圈即可找到可淘汰的缓存项
+	while (s.entries[s.hand].referenced && s.entries[s.hand].expire > now) {
+		s.entries[s.hand].referenced = false;
+		s.hand = (s.hand + 1) % s.entries.size();
+	}
+	entry &e = s.entries[s.hand];
+	s.index.erase(s.index.find(e.name));
+	s.index.emplace(name, s.hand);
+	e = entry{std::string(name), std::string(password), found, false, expire};
+	s.hand = (s.hand + 1) % s.entries.size();
+}
+
+bool credential_cache::find(shard &s, std::string_view name, CREDENTIAL_STATUS &status, std::string &password) {
+	auto it = s.index.find(name);
+	if (it == s.index.end()) return false;
+	entry &e = s.entries[it->second];
+	if (e.expire <= clock_type::now()) return false;
+	e.referenced = true;
+	_hits.fetch_add(1, std::memory_order_relaxed);
+	if (e.found) password = e.password;
+	status = e.found ? CREDENTIAL_STATUS::FOUND : CREDENTIAL_STATUS::NOT_FOUND;
+	return true;
+}
+
+void credential_cache::land(shard &s, std::string_view name, CREDENTIAL_STATUS status, std::string_view password) {
+	auto flight_it = s.flights.find(name);
+	flight &f = *flight_it->second;
+	if (status != CREDENTIAL_STATUS::ERROR && !f.stale) fill(s, name, status == CREDENTIAL_STATUS::FOUND, password);
+	f.status = status;
+	f.password.assign(password);
+	f.done = true;
+	s.flights.erase(flight_it);
+}
+
+CREDENTIAL_STATUS credential_cache::get(std::string_view name, std::string &password) {
+	shard &s = shard_of(name);
+	std::unique_lock<std::mutex> lock(s.mutex);
+	CREDENTIAL_STATUS status;
+	if (find(s, name, status, password)) return status;
+
+	// 已有线程（或协程）在检索该用户名，等待其结果
+	auto flight_it = s.flights.find(name);
+	if (flight_it != s.flights.end()) {
+		std::shared_ptr<flight> f = flight_it->second;
+		_coalesced.fetch_add(1, std::memory_order_relaxed);
+		s.cond.wait(lock, [&f]() { return f->done; });
+		if (f->status == CREDENTIAL_STATUS::FOUND) password = f->password;
+		return f->status;
+	}
+
+	// 由本线程检索，检索期间不持有分片的锁
+	s.flights.emplace(name, std::make_shared<flight>());
+	_misses.fetch_add(1, std::memory_order_relaxed);
+	lock.unlock();
+	std::string fetched;
+	status = _fetch(name, fetched);
+	lock.lock();
+	land(s, name, status, fetched);
+	lock.unlock();
+	s.cond.notify_all();
+	if (status == CREDENTIAL_STATUS::FOUND) password = std::move(fetched);
+	return status;
+}
+
+bool credential_cache::lookup(std::string_view name, CREDENTIAL_STATUS &status, std::string &password) {
+	shard &s = shard_of(name);
+	std::lock_guard<std::mutex> lock(s.mutex);
+	return find(s, name, status, password);
+}
+
+bool credential_cache::begin_fetch(std::string_view name) {
+	shard &s = shard_of(name);
+	std::lock_guard<std::mutex> lock(s.mutex);
+	_misses.fetch_add(1, std::memory_order_relaxed);
+	return s.flights.emplace(name, std::make_shared<flight>()).second;
+}
+
+void credential_cache::end_fetch(std::string_view name, CREDENTIAL_STATUS status, std::string_view password) {
+	shard &s = shard_of(name);
+	{
+		std::lock_guard<std::mutex> lock(s.mutex);
+		land(s, name, status, password);
+	}
+	s.cond.notify_all();
+}
+
+void credential_cache::put(std::string_view name, std::string_view password) {
+	shard &s = shard_of(name);
+	std::lock_guard<std::mutex> lock(s.mutex);
+	auto flight_it = s.flights.find(name);
+	if (flight_it != s.flights.end()) flight_it->second->stale = true;
+	fill(s, name, true, password);
+}
+
+std::size_t credential_cache::size() const {
+	std::size_t total = 0;
+	for (std::size_t i = 0; i < shard_count; ++i) {
+		std::lock_guard<std::mutex> lock(_shards[i].mutex);
+		total += _shards[i].entries.size();
+	}
+	return total;
+}
@@ -0,0 +1,116 @@
+#ifndef CREDENTIAL_CACHE_H
+#define CREDENTIAL_CACHE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+
+// 查找用户凭据的结果：用户存在、用户不存在、查找出错（如数据库不可用，不会被缓存）
+enum class CREDENTIAL_STATUS { FOUND, NOT_FOUND, ERROR };
+
+// 用户凭据的有界缓存，用于按需加载模式：首次查找某个用户时才从数据库检索，内存占用与活跃用户数成正比
+// 1. 按用户名的哈希值分片，每个分片拥有独立的互斥锁和固定数量的缓存项，采用CLOCK算法淘汰：
+//    命中时只设置访问标记，淘汰时跳过并清除带有访问标记的缓存项，已过期的缓存项优先淘汰
+// 2. 用户不存在的结果同样缓存（负缓存），避免不存在的用户名反复访问数据库，
+//    存在与不存在的结果分别设置有效期，过期后重新检索，以感知其他服务器实例注册的用户
+// 3. 同一用户名的并发未命中合并为一次检索（single-flight），由第一个未命中的线程检索，其余线程等待其结果
+// 4. 协程中可通过lookup、begin_fetch和end_fetch自行（以非阻塞的方式）检索，等待数据库期间不阻塞线程
+class credential_cache {
+	public:
+		// 从数据库检索用户凭据的回调函数，用户存在时将密码写入password
+		typedef std::function<CREDENTIAL_STATUS(std::string_view name, std::string &password)> fetch_type;
+
+	private:
+		typedef std::chrono::steady_clock clock_type;
+
+		// 分片数量
+		static const std::size_t shard_count = 16;
+
+		struct entry {
+			std::string name;
+			std::string password;
+			bool found; // 用户是否存在
+			bool referenced; // CLOCK算法的访问标记
+			clock_type::time_point expire; // 过期时间
+		};
+
+		// 正在进行的检索，等待的线程在结果就绪后复制结果
+		struct flight {
+			bool done = false;
+			bool stale = false; // 检索期间该用户完成了注册，检索结果已过时，不能写入缓存
+			CREDENTIAL_STATUS status = CREDENTIAL_STATUS::ERROR;
+			std::string password;
+		};
+
+		// 支持以std::string_view查找的哈希函数，查找时无需构造std::string
+		struct name_hash {
+			typedef void is_transparent;
+			std::size_t operator()(std::string_view name) const { return std::hash<std::string_view>{}(name); }
+		};
+		typedef std::unordered_map<std::string, std::size_t, name_hash, std::equal_to<>> index_type;
+		typedef std::unordered_map<std::string, std::shared_ptr<flight>, name_hash, std::equal_to<>> flight_map_type;
+
+		struct alignas(64) shard {
+			std::size_t capacity = 0; // 分片的容量
+			std::mutex mutex;
+			std::condition_variable cond; // 等待检索结果的线程在此挂起
+			index_type index; // 用户名到缓存项下标的映射
+			std::vector<entry> entries; // 缓存项，数量不超过分片容量
+			std::size_t hand = 0; // CLOCK算法的指针
+			flight_map_type flights; // 正在检索的用户名
+		};
+
+		fetch_type _fetch;
+		clock_type::duration _found_ttl; // 用户存在的结果的有效期
+		clock_type::duration _not_found_ttl; // 用户不存在的结果的有效期
+		std::unique_ptr<shard[]> _shards;
+		std::atomic<std::size_t> _hits{0}; // 命中次数
+		std::atomic<std::size_t> _misses{0}; // 未命中且由本线程检索的次数
+		std::atomic<std::size_t> _coalesced{0}; // 未命中但合并到其他线程的检索的次数
+
+	private:
+		shard& shard_of(std::string_view name) const;
+		// 写入缓存项，用户名已缓存时原地覆盖，否则在分片未满时追加，已满时按CLOCK算法淘汰一项，需持有分片的锁
+		void fill(shard &s, std::string_view name, bool found, std::string_view password);
+		// 查找未过期的缓存项，命中时写入status和password，需持有分片的锁
+		bool find(shard &s, std::string_view name, CREDENTIAL_STATUS &status, std::string &password);
+		// 结束检索：写入缓存（结果已过时或出错时除外）并移除检索，需持有分片的锁，之后由调用者唤醒等待的线程
+		void land(shard &s, std::string_view name, CREDENTIAL_STATUS status, std::string_view password);
+
+	public:
+		// capacity为缓存的用户数上限，平均分配到各分片，余数分给前面的分片，因此缓存的总数不会超过capacity
+		// capacity小于分片数量时部分分片的容量为0，其中的用户名不被缓存，每次查找都检索数据库
+		// found_ttl和not_found_ttl分别为存在和不存在的结果的有效期
+		credential_cache(fetch_type fetch, std::size_t capacity,
+				std::chrono::seconds found_ttl = std::chrono::seconds(600),
+				std::chrono::seconds not_found_ttl = std::chrono::seconds(10));
+		credential_cache(const credential_cache &rhs) = delete;
+		credential_cache& operator=(const credential_cache &rhs) = delete;
+
+		// 查找用户凭据，未命中或已过期时检索数据库，用户存在时将密码写入password
+		CREDENTIAL_STATUS get(std::string_view name, std::string &password);
+		// 只查找缓存，不检索数据库，命中且未过期时将结果写入status（用户存在时将密码写入password）并返回true
+		bool lookup(std::string_view name, CREDENTIAL_STATUS &status, std::string &password);
+		// 登记由调用者自行完成的检索，期间同一用户名的get等待其结果，调用者检索后需调用end_fetch
+		// 同一用户名已有检索在进行时返回false，此时调用者仍可自行检索，但结果不写入缓存，也无需调用end_fetch
+		bool begin_fetch(std::string_view name);
+		// 结束begin_fetch登记的检索，写入缓存（检索期间该用户完成了注册时除外）并唤醒等待该检索的线程
+		void end_fetch(std::string_view name, CREDENTIAL_STATUS status, std::string_view password);
+		// 用户注册成功后写入缓存，覆盖用户不存在的缓存项，并使正在进行的检索结果不再写入缓存
+		void put(std::string_view name, std::string_view password);
+		// 获取当前缓存的用户数
+		std::size_t size() const;
+		// 获取命中、未命中和合并的次数
+		std::size_t hit_count() const { return _hits.load(std::memory_order_relaxed); }
+		std::size_t miss_count() const { return _misses.load(std::memory_order_relaxed); }
+		std::size_t coalesced_count() const { return _coalesced.load(std::memory_order_relaxed); }
+};
+
+#endif
@@ -0,0 +1,117 @@
+#include <string>
+#include <cstdlib>
+#include <algorithm>
+#include <mysql/mysql.h>
+#include "credential_loader.h"
+#include "../pool/connection_pool.h"
+#include "../log/log.h"
+
+void credential_loader::load(connection_pool *conn_pool, const std::string &snapshot_path, std::chrono::seconds interval) {
+	_conn_pool = conn_pool;
+	_snapshot_path = snapshot_path;
+	_interval = interval;
+
+	auto start = std::chrono::steady_clock::now();
+	std::unique_ptr<credential_snapshot> snapshot(new credential_snapshot);
+	if (!_snapshot_path.empty() && snapshot->open(_snapshot_path)) {
+		// 快照中的用户名不加入布隆过滤器，快照的哈希索引本身只需一次探测即可判定用户名不存在，
+		// 逐个加入一千万个用户名需要1秒以上，违背了映射快照快速启动的初衷
+		_max_id = snapshot->max_id();
+		_snapshot.store(snapshot.get(), std::memory_order_release);
+		_snapshots.push_back(std::move(snapshot));
+		LOG_INFO("loaded credential snapshot {}: {} users, max id {}", _snapshot_path, _snapshots.back()->size(), _max_id);
+	}
+	else if (!_snapshot_path.empty()) LOG_WARN("no valid credential snapshot {}, loading all users from database", _snapshot_path);
+
+	// 启动时按快照之后新增的用户数预先分配布隆过滤器，避免逐页加入用户名时追加过多的层
+	_filter.reserve(count_new_users());
+	catch_up();
+	LOG_INFO("loaded {} users in {} ms", (_snapshots.empty() ? 0 : _snapshots.back()->size()) + _store.size(),
+			std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+	if (!_snapshot_path.empty()) _worker = std::thread(&credential_loader::sync, this);
+}
+
+std::size_t credential_loader::count_new_users() {
+	MYSQL *mysql = nullptr;
+	sql_connection mysql_conn(&mysql, _conn_pool);
+	std::string sql = "SELECT COUNT(*) FROM user WHERE id > " + std::to_string(_max_id);
+	MYSQL_RES *result = nullptr;
+	if (mysql_query(mysql, sql.c_str()) || !(result = mysql_store_result(mysql))) {
+		LOG_ERROR("mysql select error: {}", mysql_error(mysql));
+		return 0;
+	}
+	MYSQL_ROW row = mysql_fetch_row(result);
+	std::size_t count = row && row[0] ? std::strtoull(row[0], nullptr, 10) : 0;
+	mysql_free_result(result);
+	return count;
+}
+
+// 按id分页（WHERE id > ? ORDER BY id LIMIT），每页只缓存有限的结果集，且不会重复检索已同步的用户
+bool credential_loader::catch_up() {
+	MYSQL *mysql = nullptr;
+	sql_connection mysql_conn(&mysql, _conn_pool);
+	while (true) {
+		std::string sql = "SELECT id, username, passwd FROM user WHERE id > " + std::to_string(_max_id)
+			+ " ORDER BY id LIMIT " + std::to_string(page_size);
+		MYSQL_RES *result = nullptr;
+		if (mysql_query(mysql, sql.c_str()) || !(result = mysql_store_result(mysql))) {
+			LOG_ERROR("mysql select error: {}", mysql_error(mysql));
+			return false;
+		}
+		std::size_t rows = 0;
+		while (MYSQL_ROW row = mysql_fetch_row(result)) {
+			++rows;
+			_max_id = std::strtoull(row[0], nullptr, 10);
+			// 先加入布隆过滤器再写入凭据存储，确保在凭据存储中可见的用户名不会被判定为一定不存在
+			_filter.add(row[1]);
+			_store.insert(row[1], row[2]);
+			if (!_snapshot_path.empty()) _pending.emplace_back(row[1], row[2]);
+		}
+		mysql_free_result(result);
+		if (rows < page_size) return true;
+	}
+}
+
+void credential_loader::write_snapshot() {
+	const credential_snapshot *base = _snapshot.load(std::memory_order_relaxed);
+	auto start = std::chrono::steady_clock::now();
+	if (!credential_snapshot::write(_snapshot_path, base, _pending, _max_id)) {
+		LOG_ERROR("failed to write credential snapshot {}", _snapshot_path);
+		return;
+	}
+	std::unique_ptr<credential_snapshot> snapshot(new credential_snapshot);
+	if (!snapshot->open(_snapshot_path)) {
+		LOG_ERROR("failed to open credential snapshot {}", _snapshot_path);
+		return;
+	}
+	LOG_INFO("wrote credential snapshot {}: {} users, max id {}, {} ms", _snapshot_path, snapshot->size(), _max_id,
+			std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+	// 新增的用户已在凭据存储中，切换快照后无需从中删除
+	_pending.clear();
+	_snapshot.store(snapshot.get(), std::memory_order_release);
+	_snapshots.push_back(std::move(snapshot));
+}
+
+void credential_loader::sync() {
+	while (true) {
+		const credential_snapshot *base = _snapshot.load(std::memory_order_relaxed);
+		std::size_t threshold = std::max(min_snapshot_rows, (base ? base->size() : 0) / 8);
+		// 没有快照文件时，只要有用户就写入
+		if ((!base && !_pending.empty()) || _pending.size() >= threshold) write_snapshot();
+
+		std::unique_lock<std::mutex> lock(_mutex);
+		if (_cond.wait_for(lock, _interval, [this]() { return _stop; })) break;
+		lock.unlock();
+		catch_up();
+	}
+}
+
+void credential_loader::stop() {
+	if (!_worker.joinable()) return;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stop = true;
+		_cond.notify_one();
+	}
+	_worker.join();
+}
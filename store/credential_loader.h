@@ -0,0 +1,86 @@
+#ifndef CREDENTIAL_LOADER_H
+#define CREDENTIAL_LOADER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include "credential_store.h"
+#include "credential_snapshot.h"
+#include "bloom_filter.h"
+
+class connection_pool;
+
+// 用户凭据的加载器，负责在启动时准备登录和注册校验所需的用户数据，并与数据库保持同步
+// 1. 启动时映射快照文件，快照中的用户直接在映射的文件中查找，无需复制到内存，
+//    然后按id增量检索快照之后新增的用户，加入凭据存储（通常只有少量用户，只需几秒）
+// 2. 后台线程定期增量检索数据库中新增的用户（如其他服务器实例注册的用户），
+//    新增的用户累积到快照的1/8时，合并写入新的快照文件并切换映射，使重写快照的开销均摊到每个用户上
+// 3. 没有快照文件时，按id分页检索所有用户，之后由后台线程写入快照文件，下次启动即可使用
+// 旧的映射可能仍被工作线程访问，因此保留到加载器析构时才解除
+class credential_loader {
+	private:
+		typedef std::vector<std::pair<std::string, std::string>> row_list_type;
+
+		// 每次分页检索的用户数
+		static const std::size_t page_size = 10000;
+		// 触发重写快照的最少新增用户数
+		static const std::size_t min_snapshot_rows = 1024;
+
+		credential_store &_store; // 快照之后新增的用户
+		bloom_filter &_filter; // 凭据存储中的用户名的布隆过滤器
+		connection_pool *_conn_pool = nullptr;
+		std::string _snapshot_path; // 快照文件路径，为空表示不使用快照
+		std::vector<std::unique_ptr<credential_snapshot>> _snapshots; // 当前和已被替换的快照
+		std::atomic<const credential_snapshot*> _snapshot{nullptr}; // 当前的快照，工作线程无锁访问
+		row_list_type _pending; // 已从数据库同步但尚未写入快照的用户，只由加载线程或同步线程访问
+		std::uint64_t _max_id = 0; // 已同步的最大用户id
+		std::thread _worker; // 后台同步线程
+		std::mutex _mutex; // 用于定时挂起/唤醒同步线程的互斥锁和条件变量
+		std::condition_variable _cond;
+		bool _stop = false; // 同步线程是否需要退出
+		std::chrono::seconds _interval{60}; // 后台同步的间隔
+
+	private:
+		// 统计数据库中id大于已同步的最大id的用户数，用于预先分配布隆过滤器，失败时返回0
+		std::size_t count_new_users();
+		// 从数据库分页检索id大于已同步的最大id的用户，加入布隆过滤器和凭据存储，返回是否成功
+		bool catch_up();
+		// 将当前快照与新增的用户合并写入快照文件，并切换为新的快照
+		void write_snapshot();
+		// 作为同步线程的回调函数，定期增量同步并在需要时重写快照
+		void sync();
+
+	public:
+		credential_loader(credential_store &store, bloom_filter &filter) : _store(store), _filter(filter) {}
+		credential_loader(const credential_loader &rhs) = delete;
+		credential_loader& operator=(const credential_loader &rhs) = delete;
+		// 析构函数，需要等待同步线程退出
+		~credential_loader() { stop(); }
+
+		// 加载用户数据，snapshot_path为空时从数据库检索所有用户且不启动同步线程
+		void load(connection_pool *conn_pool, const std::string &snapshot_path = "",
+				std::chrono::seconds interval = std::chrono::seconds(60));
+		// 通知同步线程退出并等待，需在销毁连接池之前调用
+		void stop();
+
+		// 判断用户名是否在快照中
+		bool contains(std::string_view name) const {
+			const credential_snapshot *snapshot = _snapshot.load(std::memory_order_acquire);
+			return snapshot && snapshot->contains(name);
+		}
+		// 在快照中进行登录校验
+		bool verify(std::string_view name, std::string_view password) const {
+			const credential_snapshot *snapshot = _snapshot.load(std::memory_order_acquire);
+			return snapshot && snapshot->verify(name, password);
+		}
+};
+
+#endif
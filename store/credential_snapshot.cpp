@@ -0,0 +1,165 @@
+#include <cstring>
+#include <unordered_set>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "credential_snapshot.h"
+
+namespace {
+
+const char snapshot_magic[8] = {'W', 'S', 'C', 'R', 'E', 'D', '0', '1'};
+
+// 循环写入，直到写完所有数据或出错
+bool write_all(int fd, const char *data, std::size_t size) {
+	while (size > 0) {
+		ssize_t ret = ::write(fd, data, size);
+		if (ret < 0 && errno == EINTR) continue;
+		if (ret <= 0) return false;
+		data += ret;
+		size -= static_cast<std::size_t>(ret);
+	}
+	return true;
+}
+
+}
+
+credential_snapshot::~credential_snapshot() {
+	if (_address) munmap(_address, _size);
+}
+
+// FNV-1a哈希，最后采用MurmurHash3的fmix64混合，使低位（选择槽位）和高位（哈希标记）都分布均匀
+std::uint64_t credential_snapshot::hash(std::string_view name) {
+	std::uint64_t h = 0xcbf29ce484222325ULL;
+	for (unsigned char c : name) { h ^= c; h *= 0x100000001b3ULL; }
+	h ^= h >> 33; h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33; h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+std::string_view credential_snapshot::name_of(const char *record) {
+	std::uint32_t name_size;
+	std::memcpy(&name_size, record, sizeof(name_size));
+	return {record + 8, name_size};
+}
+
+std::string_view credential_snapshot::password_of(const char *record) {
+	std::uint32_t name_size, password_size;
+	std::memcpy(&name_size, record, sizeof(name_size));
+	std::memcpy(&password_size, record + 4, sizeof(password_size));
+	return {record + 8 + name_size, password_size};
+}
+
+const char* credential_snapshot::record_at(std::uint64_t offset) const {
+	std::uint64_t data_size = _header->data_size;
+	if (offset >= data_size || data_size - offset < 8) return nullptr;
+	std::uint32_t name_size, password_size;
+	std::memcpy(&name_size, _data + offset, sizeof(name_size));
+	std::memcpy(&password_size, _data + offset + 4, sizeof(password_size));
+	if (std::uint64_t(name_size) + password_size > data_size - offset - 8) return nullptr;
+	return _data + offset;
+}
+
+// 映射后校验文件头和各区域的大小，避免截断或损坏的快照文件导致越界访问
+bool credential_snapshot::open(const std::string &path) {
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) return false;
+	struct stat st;
+	if (fstat(fd, &st) < 0 || static_cast<std::size_t>(st.st_size) < index_offset) { ::close(fd); return false; }
+	std::size_t size = static_cast<std::size_t>(st.st_size);
+	void *address = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (address == MAP_FAILED) return false;
+
+	const header *h = static_cast<const header*>(address);
+	bool valid = std::memcmp(h->magic, snapshot_magic, sizeof(snapshot_magic)) == 0
+		&& h->capacity > 0 && (h->capacity & (h->capacity - 1)) == 0 && h->count < h->capacity
+		&& h->capacity <= (size - index_offset) / 8 && index_offset + h->capacity * 8 + h->data_size == size;
+	if (!valid) { munmap(address, size); return false; }
+
+	if (_address) munmap(_address, _size);
+	_address = address;
+	_size = size;
+	_header = h;
+	_index = reinterpret_cast<const std::uint64_t*>(static_cast<const char*>(address) + index_offset);
+	_data = reinterpret_cast<const char*>(_index + h->capacity);
+	// 哈希索引为随机访问，提前异步读入，凭据记录区按需读入
+	madvise(address, index_offset + h->capacity * 8, MADV_WILLNEED);
+	return true;
+}
+
+const char* credential_snapshot::find(std::string_view name) const {
+	if (!_header) return nullptr;
+	// 最多探测capacity个槽位，即使损坏的哈希索引中没有空槽位也能结束
+	std::uint64_t h = hash(name), tag = h >> 48, mask = _header->capacity - 1;
+	for (std::uint64_t n = 0, i = h & mask; n < _header->capacity; ++n, i = (i + 1) & mask) {
+		std::uint64_t slot = _index[i];
+		if (slot == 0) return nullptr;
+		if ((slot >> 48) != tag) continue;
+		const char *record = record_at((slot & 0xffffffffffff) - 1);
+		if (record && name_of(record) == name) return record;
+	}
+	return nullptr;
+}
+
+bool credential_snapshot::verify(std::string_view name, std::string_view password) const {
+	const char *record = find(name);
+	return record && password_of(record) == password;
+}
+
+// 先在内存中构造哈希索引（每个用户8字节），再依次写入文件头、哈希索引和凭据记录
+// 新增的凭据中与旧快照重复或彼此重复的用户名只保留第一个
+bool credential_snapshot::write(const std::string &path, const credential_snapshot *base,
+		const std::vector<std::pair<std::string, std::string>> &rows, std::uint64_t max_id) {
+	std::unordered_set<std::string_view> seen;
+	std::vector<bool> skip(rows.size(), false);
+	std::size_t count = base ? base->size() : 0;
+	for (std::size_t i = 0; i < rows.size(); ++i) {
+		if ((base && base->contains(rows[i].first)) || !seen.insert(rows[i].first).second) skip[i] = true;
+		else ++count;
+	}
+
+	header h{};
+	std::memcpy(h.magic, snapshot_magic, sizeof(snapshot_magic));
+	h.count = count;
+	h.max_id = max_id;
+	h.capacity = 16;
+	while (h.capacity * 3 / 4 < count + 1) h.capacity <<= 1;
+	std::vector<std::uint64_t> index(h.capacity, 0);
+	auto add = [&h, &index](std::string_view name, std::string_view password) {
+		std::uint64_t hv = hash(name), mask = h.capacity - 1, i = hv & mask;
+		while (index[i] != 0) i = (i + 1) & mask;
+		index[i] = ((hv >> 48) << 48) | (h.data_size + 1);
+		h.data_size += record_size(name.size(), password.size());
+	};
+	if (base) base->for_each(add);
+	for (std::size_t i = 0; i < rows.size(); ++i) if (!skip[i]) add(rows[i].first, rows[i].second);
+
+	std::string tmp_path = path + ".tmp";
+	int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) return false;
+	char head[index_offset] = {};
+	std::memcpy(head, &h, sizeof(h));
+	bool ok = write_all(fd, head, sizeof(head))
+		&& write_all(fd, reinterpret_cast<const char*>(index.data()), index.size() * sizeof(std::uint64_t));
+
+	// 凭据记录经由1MB的缓冲区批量写入
+	std::string buffer;
+	buffer.reserve(1 << 20);
+	auto put = [&ok, &buffer, fd](std::string_view name, std::string_view password) {
+		std::uint32_t sizes[2] = {static_cast<std::uint32_t>(name.size()), static_cast<std::uint32_t>(password.size())};
+		buffer.append(reinterpret_cast<const char*>(sizes), sizeof(sizes));
+		buffer.append(name).append(password);
+		buffer.append(record_size(name.size(), password.size()) - 8 - name.size() - password.size(), '\0');
+		if (buffer.size() >= (1 << 20)) { ok = ok && write_all(fd, buffer.data(), buffer.size()); buffer.clear(); }
+	};
+	if (ok && base) base->for_each(put);
+	for (std::size_t i = 0; ok && i < rows.size(); ++i) if (!skip[i]) put(rows[i].first, rows[i].second);
+	ok = ok && write_all(fd, buffer.data(), buffer.size()) && fdatasync(fd) == 0;
+	ok = ::close(fd) == 0 && ok;
+	if (ok && rename(tmp_path.c_str(), path.c_str()) == 0) return true;
+	unlink(tmp_path.c_str());
+	return false;
+}
@@ -0,0 +1,84 @@
+#ifndef CREDENTIAL_SNAPSHOT_H
+#define CREDENTIAL_SNAPSHOT_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+// 用户凭据的快照文件，启动时通过mmap映射后即可直接用于登录和注册校验，无需从数据库检索所有用户
+// 文件格式（小端序）：
+// 1. 64字节的文件头：magic、用户数、快照包含的最大用户id、哈希索引的槽位数、凭据记录区的字节数
+// 2. 哈希索引：槽位数（2的幂）个64位槽位，高16位为哈希标记，低48位为凭据记录在记录区的偏移加1，为0表示空槽位
+// 3. 凭据记录区：依次存放凭据记录，每条记录为用户名长度、密码长度（均为32位），其后为用户名和密码，按8字节对齐
+// 哈希函数采用FNV-1a加上混合，不依赖标准库的实现，快照文件可跨编译器和版本使用
+// 快照文件只读，更新时写入新文件后原子地重命名替换，已映射的旧文件不受影响
+class credential_snapshot {
+	private:
+		struct header {
+			char magic[8];
+			std::uint64_t count; // 用户数
+			std::uint64_t max_id; // 快照包含的最大用户id，之后的用户需从数据库增量同步
+			std::uint64_t capacity; // 哈希索引的槽位数
+			std::uint64_t data_size; // 凭据记录区的字节数
+		};
+		// 哈希索引在文件中的偏移，即文件头的大小
+		static const std::size_t index_offset = 64;
+
+		void *_address = nullptr; // 映射的起始地址
+		std::size_t _size = 0; // 映射的字节数
+		const header *_header = nullptr;
+		const std::uint64_t *_index = nullptr;
+		const char *_data = nullptr;
+
+	private:
+		static std::uint64_t hash(std::string_view name);
+		// 凭据记录的字节数（按8字节对齐）
+		static std::size_t record_size(std::size_t name_size, std::size_t password_size) {
+			return (8 + name_size + password_size + 7) & ~std::size_t(7);
+		}
+		static std::string_view name_of(const char *record);
+		static std::string_view password_of(const char *record);
+		// 获取记录区中偏移为offset的凭据记录，记录超出记录区时返回nullptr，防止损坏的快照文件导致越界访问
+		const char* record_at(std::uint64_t offset) const;
+		// 在哈希索引中查找用户名，返回凭据记录的地址，不存在则返回nullptr
+		const char* find(std::string_view name) const;
+
+	public:
+		credential_snapshot() = default;
+		credential_snapshot(const credential_snapshot &rhs) = delete;
+		credential_snapshot& operator=(const credential_snapshot &rhs) = delete;
+		// 析构时解除映射
+		~credential_snapshot();
+
+		// 以只读方式映射快照文件，文件不存在或格式不正确时返回false
+		bool open(const std::string &path);
+		// 判断用户名是否存在
+		bool contains(std::string_view name) const { return find(name) != nullptr; }
+		// 登录校验：用户名存在且密码一致时返回true
+		bool verify(std::string_view name, std::string_view password) const;
+		// 获取用户数
+		std::size_t size() const { return _header ? _header->count : 0; }
+		// 获取快照包含的最大用户id
+		std::uint64_t max_id() const { return _header ? _header->max_id : 0; }
+
+		// 按文件中的顺序遍历所有凭据，顺序访问映射的文件，可利用内核的预读
+		template <typename Function>
+		void for_each(Function function) const {
+			for (std::size_t offset = 0; _data && offset < _header->data_size; ) {
+				const char *record = record_at(offset);
+				if (!record) break;
+				std::string_view name = name_of(record), password = password_of(record);
+				function(name, password);
+				offset += record_size(name.size(), password.size());
+			}
+		}
+
+		// 将旧快照（可为nullptr）中的所有凭据与新增的凭据合并，写入新的快照文件
+		// 先写入临时文件并落盘，再重命名为path，写入失败时不影响原有的快照文件
+		static bool write(const std::string &path, const credential_snapshot *base,
+				const std::vector<std::pair<std::string, std::string>> &rows, std::uint64_t max_id);
+};
+
+#endif
@@ -0,0 +1,101 @@
+#include <functional>
+#include <cstring>
+#include <algorithm>
+#include "credential_store.h"
+
+credential_store::table::table(std::size_t cap) : capacity(cap), slots(new slot_type[cap]) {
+	for (std::size_t i = 0; i < capacity; ++i) slots[i].store(0, std::memory_order_relaxed);
+}
+
+// 按预计的用户数为每个分片预先分配槽位数组，负载因子不超过3/4
+credential_store::credential_store(std::size_t expected) : _shards(new shard[shard_count]) {
+	std::size_t capacity = 16;
+	while (capacity * 3 / 4 * shard_count < expected) capacity <<= 1;
+	for (std::size_t i = 0; i < shard_count; ++i) {
+		_shards[i].tables.emplace_back(new table(capacity));
+		_shards[i].current.store(_shards[i].tables.back().get(), std::memory_order_release);
+	}
+}
+
+std::uint64_t credential_store::hash(std::string_view name) {
+	return std::hash<std::string_view>{}(name);
+}
+
+// 读线程不加锁：先以acquire读取当前的槽位数组，再以acquire读取槽位
+// 写线程在发布槽位之前已写完凭据记录，因此读到非空槽位时，记录的内容一定完整
+// 遇到空槽位即表示用户名不存在（只插入不删除，探测序列中不会出现空洞）
+const credential_store::record* credential_store::find(std::string_view name) const {
+	std::uint64_t h = hash(name);
+	const table *t = _shards[h >> (64 - shard_bits)].current.load(std::memory_order_acquire);
+	std::size_t mask = t->capacity - 1;
+	std::uint64_t tag = tag_of(h);
+	for (std::size_t i = h & mask; ; i = (i + 1) & mask) {
+		std::uint64_t slot = t->slots[i].load(std::memory_order_acquire);
+		if (slot == 0) return nullptr;
+		if ((slot >> 48) == tag && record_of(slot)->name() == name) return record_of(slot);
+	}
+}
+
+bool credential_store::verify(std::string_view name, std::string_view password) const {
+	const record *r = find(name);
+	return r && r->password() == password;
+}
+
+std::size_t credential_store::size() const {
+	std::size_t total = 0;
+	for (std::size_t i = 0; i < shard_count; ++i) total += _shards[i].size.load(std::memory_order_relaxed);
+	return total;
+}
+
+// 加锁后再次查找，确保并发注册同一用户名时只有一个成功
+bool credential_store::insert(std::string_view name, std::string_view password) {
+	std::uint64_t h = hash(name);
+	shard &s = _shards[h >> (64 - shard_bits)];
+	std::lock_guard<std::mutex> lock(s.mutex);
+	if ((s.size + 1) * 4 > s.current.load(std::memory_order_relaxed)->capacity * 3) grow(s);
+
+	table *t = s.current.load(std::memory_order_relaxed);
+	std::size_t mask = t->capacity - 1;
+	std::uint64_t tag = tag_of(h);
+	std::size_t i = h & mask;
+	for (std::uint64_t slot; (slot = t->slots[i].load(std::memory_order_relaxed)) != 0; i = (i + 1) & mask)
+		if ((slot >> 48) == tag && record_of(slot)->name() == name) return false;
+
+	const record *r = allocate(s, name, password);
+	t->slots[i].store((tag << 48) | reinterpret_cast<std::uintptr_t>(r), std::memory_order_release);
+	s.size.store(s.size + 1, std::memory_order_relaxed);
+	return true;
+}
+
+// 凭据记录按8字节对齐，超过内存块大小的记录单独分配一个内存块
+const credential_store::record* credential_store::allocate(shard &s, std::string_view name, std::string_view password) {
+	std::size_t size = (sizeof(record) + name.size() + password.size() + 7) & ~std::size_t(7);
+	if (s.chunk_used + size > chunk_size) {
+		s.chunks.emplace_back(new char[std::max(size, chunk_size)]);
+		s.chunk_used = 0;
+	}
+	char *address = s.chunks.back().get() + s.chunk_used;
+	s.chunk_used += size;
+	record *r = reinterpret_cast<record*>(address);
+	r->name_size = static_cast<std::uint32_t>(name.size());
+	r->password_size = static_cast<std::uint32_t>(password.size());
+	std::memcpy(address + sizeof(record), name.data(), name.size());
+	std::memcpy(address + sizeof(record) + name.size(), password.data(), password.size());
+	return r;
+}
+
+// 新数组完全构造好之后才发布，读线程要么访问旧数组，要么访问新数组，旧数组保留到析构时释放
+void credential_store::grow(shard &s) {
+	const table *old = s.current.load(std::memory_order_relaxed);
+	table *t = new table(old->capacity * 2);
+	std::size_t mask = t->capacity - 1;
+	for (std::size_t i = 0; i < old->capacity; ++i) {
+		std::uint64_t slot = old->slots[i].load(std::memory_order_relaxed);
+		if (slot == 0) continue;
+		std::size_t j = hash(record_of(slot)->name()) & mask;
+		while (t->slots[j].load(std::memory_order_relaxed) != 0) j = (j + 1) & mask;
+		t->slots[j].store(slot, std::memory_order_relaxed);
+	}
+	s.tables.emplace_back(t);
+	s.current.store(t, std::memory_order_release);
+}
@@ -0,0 +1,86 @@
+#ifndef CREDENTIAL_STORE_H
+#define CREDENTIAL_STORE_H
+
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+// 用户凭据（用户名和密码）的内存存储，用于登录和注册校验，读多写少
+// 采用分片的开放寻址哈希表（线性探测），按哈希值的高位选择分片，每个分片拥有独立的写锁
+// 1. 读操作（登录校验）不加锁：槽位只会从空变为指向凭据记录，凭据记录写入后不再修改，
+//    因此读线程通过acquire读取槽位即可看到完整的记录，多个工作线程的登录校验互不干扰
+// 2. 写操作（注册）只锁住所在的分片，不同分片的注册可并行执行
+// 3. 扩容时在写锁内构造新的槽位数组并原子地发布（类似RCU），旧数组可能仍被读线程访问，
+//    因此延迟到存储析构时才释放，由于按2倍扩容，旧数组的总大小不超过当前数组
+// 凭据记录分配在分片独占的内存块中，不会移动也不会单独释放，只支持插入，不支持删除和修改
+class credential_store {
+	private:
+		// 分片数量（2的幂），按哈希值的最高6位选择分片
+		static const std::size_t shard_bits = 6;
+		static const std::size_t shard_count = std::size_t(1) << shard_bits;
+		// 每次为凭据记录分配的内存块大小
+		static const std::size_t chunk_size = 256 * 1024;
+
+		// 凭据记录：用户名长度、密码长度，其后依次为用户名和密码（均不以\0结尾）
+		struct record {
+			std::uint32_t name_size;
+			std::uint32_t password_size;
+			std::string_view name() const { return {reinterpret_cast<const char*>(this + 1), name_size}; }
+			std::string_view password() const { return {reinterpret_cast<const char*>(this + 1) + name_size, password_size}; }
+		};
+
+		// 槽位为64位整数：高16位为哈希标记，低48位为凭据记录的地址，为0表示空槽位
+		// 探测时先比较哈希标记，标记相同才访问凭据记录，避免大多数无关记录的缓存未命中
+		typedef std::atomic<std::uint64_t> slot_type;
+
+		// 槽位数组，容量为2的幂
+		struct table {
+			std::size_t capacity;
+			std::unique_ptr<slot_type[]> slots;
+			explicit table(std::size_t cap);
+		};
+
+		// 分片独占一个缓存行，避免不同分片的写锁和计数器之间的伪共享
+		struct alignas(64) shard {
+			std::atomic<table*> current{nullptr}; // 当前的槽位数组，读线程无锁访问
+			std::mutex mutex; // 写锁
+			std::atomic<std::size_t> size{0}; // 凭据记录数，只在写锁内修改
+			std::vector<std::unique_ptr<table>> tables; // 当前和已被替换的槽位数组
+			std::vector<std::unique_ptr<char[]>> chunks; // 凭据记录所在的内存块
+			std::size_t chunk_used = chunk_size; // 当前内存块已使用的字节数
+		};
+
+		std::unique_ptr<shard[]> _shards;
+
+	private:
+		static std::uint64_t hash(std::string_view name);
+		static std::uint64_t tag_of(std::uint64_t h) { return (h >> 32) & 0xffff; }
+		static const record* record_of(std::uint64_t slot) { return reinterpret_cast<const record*>(slot & 0xffffffffffff); }
+		// 在分片中无锁地查找用户名，不存在则返回nullptr
+		const record* find(std::string_view name) const;
+		// 在分片的内存块中分配并写入凭据记录，需持有分片的写锁
+		static const record* allocate(shard &s, std::string_view name, std::string_view password);
+		// 将槽位数组扩容为2倍并发布，需持有分片的写锁
+		static void grow(shard &s);
+
+	public:
+		// expected为预计的用户数，用于预先分配槽位数组，避免加载大量用户时反复扩容
+		explicit credential_store(std::size_t expected = 0);
+		credential_store(const credential_store &rhs) = delete;
+		credential_store& operator=(const credential_store &rhs) = delete;
+
+		// 插入凭据，若用户名已存在则不修改并返回false，可用于注册时原子地占用用户名
+		bool insert(std::string_view name, std::string_view password);
+		// 判断用户名是否存在
+		bool contains(std::string_view name) const { return find(name) != nullptr; }
+		// 登录校验：用户名存在且密码一致时返回true
+		bool verify(std::string_view name, std::string_view password) const;
+		// 获取凭据记录数
+		std::size_t size() const;
+};
+
+#endif
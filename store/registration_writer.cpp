@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <cstring>
+#include <mysql/mysql.h>
+#include <mysql/mysqld_error.h>
+#include "registration_writer.h"
+#include "../pool/connection_pool.h"
+#include "../log/log.h"
+
+void registration_writer::init(connection_pool *conn_pool, REGISTER_ACK ack, std::size_t batch_rows,
+		std::chrono::milliseconds interval) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (_flusher.joinable()) return;
+	_conn_pool = conn_pool;
+	_ack = ack;
+	_batch_rows = batch_rows > 0 ? batch_rows : 1;
+	_interval = interval;
+	_stop = false;
+	_flusher = std::thread(&registration_writer::flush, this);
+}
+
+bool registration_writer::submit(std::string_view name, std::string_view password) {
+	ticket waiter;
+	std::unique_lock<std::mutex> lock(_mutex);
+	if (!_flusher.joinable() || _stop) return false;
+	if (_queue.empty()) _oldest = std::chrono::steady_clock::now();
+	_queue.push_back(pending{std::string(name), std::string(password), _ack == REGISTER_ACK::COMMITTED ? &waiter : nullptr, nullptr});
+	// 队列从空变为非空时需唤醒后台线程开始计时，达到批量大小时需唤醒后台线程立即写入
+	if (_queue.size() == 1 || _queue.size() >= _batch_rows) _flush_cond.notify_one();
+	if (_ack == REGISTER_ACK::QUEUED) return true;
+	_done_cond.wait(lock, [&waiter]() { return waiter.done; });
+	return waiter.ok;
+}
+
+bool registration_writer::submit(std::string_view name, std::string_view password, std::function<void(bool)> done) {
+	std::unique_lock<std::mutex> lock(_mutex);
+	if (!_flusher.joinable() || _stop) return false;
+	if (_queue.empty()) _oldest = std::chrono::steady_clock::now();
+	bool queued = _ack == REGISTER_ACK::QUEUED;
+	_queue.push_back(pending{std::string(name), std::string(password), nullptr, queued ? nullptr : std::move(done)});
+	if (_queue.size() == 1 || _queue.size() >= _batch_rows) _flush_cond.notify_one();
+	lock.unlock();
+	if (queued) done(true);
+	return true;
+}
+
+namespace {
+
+// 将一个用户的用户名和密码绑定到预处理语句的第2i和2i+1个参数
+void bind_user(MYSQL_BIND *params, unsigned long *lengths, std::size_t i, const std::string &name, const std::string &password) {
+	lengths[2 * i] = name.size();
+	lengths[2 * i + 1] = password.size();
+	params[2 * i].buffer_type = MYSQL_TYPE_STRING;
+	params[2 * i].buffer = const_cast<char*>(name.data());
+	params[2 * i].length = &lengths[2 * i];
+	params[2 * i + 1].buffer_type = MYSQL_TYPE_STRING;
+	params[2 * i + 1].buffer = const_cast<char*>(password.data());
+	params[2 * i + 1].length = &lengths[2 * i + 1];
+}
+
+}
+
+// 通过预处理语句插入batch中从first开始的rows个用户
+bool registration_writer::insert_users(MYSQL_STMT *stmt, const std::vector<pending> &batch, std::size_t first, std::size_t rows) {
+	if (!stmt) return false;
+	MYSQL_BIND params[2 * sql_batch_rows];
+	unsigned long lengths[2 * sql_batch_rows];
+	std::memset(params, 0, sizeof(params));
+	for (std::size_t i = 0; i < rows; ++i) bind_user(params, lengths, i, batch[first + i].name, batch[first + i].password);
+	return !mysql_stmt_bind_param(stmt, params) && !mysql_stmt_execute(stmt);
+}
+
+// 只有用户名重复（ER_DUP_ENTRY）是单个用户的失败，单条INSERT失败只回滚该条语句，不影响同一事务中已写入的用户
+// 其他错误（如ER_LOCK_DEADLOCK、ER_LOCK_WAIT_TIMEOUT）可能已回滚整个事务，之前写入成功的用户也已丢失，因此整批失败
+bool registration_writer::try_write_batch(MYSQL *mysql, MYSQL_STMT *single, MYSQL_STMT *multi,
+		const std::vector<pending> &batch, std::vector<bool> &ok) {
+	ok.assign(batch.size(), false);
+	// 语句执行失败且不是用户名重复时返回true
+	auto fatal = [](MYSQL_STMT *stmt) {
+		if (!stmt) { LOG_ERROR("mysql insert error: {}", "statement not prepared"); return true; }
+		if (mysql_stmt_errno(stmt) == ER_DUP_ENTRY) return false;
+		LOG_ERROR("mysql insert error {}: {}", mysql_stmt_errno(stmt), mysql_stmt_error(stmt));
+		return true;
+	};
+	auto insert_single = [&](std::size_t j) {
+		if (insert_users(single, batch, j, 1)) ok[j] = true;
+		else if (fatal(single)) return false;
+		return true;
+	};
+	std::size_t i = 0;
+	for (; i + sql_batch_rows <= batch.size(); i += sql_batch_rows) {
+		if (insert_users(multi, batch, i, sql_batch_rows)) { std::fill(ok.begin() + i, ok.begin() + i + sql_batch_rows, true); continue; }
+		// 多行INSERT未预处理时同样逐行写入
+		if (multi && fatal(multi)) return false;
+		for (std::size_t j = i; j < i + sql_batch_rows; ++j) if (!insert_single(j)) return false;
+	}
+	for (; i < batch.size(); ++i) if (!insert_single(i)) return false;
+	if (mysql_commit(mysql)) {
+		LOG_ERROR("mysql commit error {}: {}", mysql_errno(mysql), mysql_error(mysql));
+		return false;
+	}
+	return true;
+}
+
+// 整批失败时回滚事务并重试整个批次，重试max_batch_retries次后仍失败则所有用户写入失败
+std::vector<bool> registration_writer::write_batch(const std::vector<pending> &batch) {
+	std::vector<bool> ok(batch.size(), false);
+
+	MYSQL *mysql = nullptr;
+	sql_connection mysql_conn(&mysql, _conn_pool);
+	if (!mysql) return ok;
+	MYSQL_STMT *single = mysql_conn.statement(SQL_STATEMENT::INSERT_USER);
+	MYSQL_STMT *multi = mysql_conn.statement(SQL_STATEMENT::INSERT_USER_BATCH);
+	mysql_autocommit(mysql, false);
+	for (int attempt = 0; ; ++attempt) {
+		if (try_write_batch(mysql, single, multi, batch, ok)) break;
+		mysql_rollback(mysql);
+		ok.assign(batch.size(), false);
+		if (attempt == max_batch_retries) break;
+	}
+	mysql_autocommit(mysql, true);
+	return ok;
+}
+
+void registration_writer::flush() {
+	std::vector<pending> batch;
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (true) {
+		_flush_cond.wait(lock, [this]() { return _stop || !_queue.empty(); });
+		if (_queue.empty()) break;
+		// QUEUED方式下无人等待，可等待更多的用户组成更大的批次；停止时不再等待，直接写入剩余的用户
+		// COMMITTED方式下工作线程正在等待，因此立即写入，写入期间到达的用户自然组成下一批次
+		if (_ack == REGISTER_ACK::QUEUED)
+			_flush_cond.wait_until(lock, _oldest + _interval, [this]() { return _stop || _queue.size() >= _batch_rows; });
+		batch.swap(_queue);
+		lock.unlock();
+
+		std::vector<bool> ok = write_batch(batch);
+		std::size_t failed = std::count(ok.begin(), ok.end(), false);
+		if (failed > 0)
+			LOG_ERROR("failed to persist {} of {} registered users, first: {}", failed, batch.size(),
+					batch[std::find(ok.begin(), ok.end(), false) - ok.begin()].name);
+
+		// 异步提交的回调可能恢复等待提交的协程，因此在不持有锁的情况下调用
+		for (std::size_t i = 0; i < batch.size(); ++i)
+			if (batch[i].done) batch[i].done(ok[i]);
+
+		lock.lock();
+		for (std::size_t i = 0; i < batch.size(); ++i) {
+			if (!batch[i].waiter) continue;
+			batch[i].waiter->ok = ok[i];
+			batch[i].waiter->done = true;
+		}
+		_done_cond.notify_all();
+		batch.clear();
+	}
+}
+
+void registration_writer::stop() {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (!_flusher.joinable()) return;
+		_stop = true;
+		_flush_cond.notify_one();
+	}
+	_flusher.join();
+}
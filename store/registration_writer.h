@@ -0,0 +1,94 @@
+#ifndef REGISTRATION_WRITER_H
+#define REGISTRATION_WRITER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+
+#include <mysql/mysql.h>
+
+class connection_pool;
+
+// 注册的持久化确认方式
+// 1. QUEUED：用户写入队列后即确认注册成功，进程崩溃时可能丢失尚未写入数据库的用户
+// 2. COMMITTED：等待用户所在的批次提交后才确认，并发的注册共享一次提交（组提交）
+enum class REGISTER_ACK { QUEUED, COMMITTED };
+
+// 注册用户的后写（write-behind）队列，由后台线程批量写入数据库
+// 工作线程将用户写入队列后即可返回（或等待提交），注册不再串行地经过一次数据库往返，
+// QUEUED方式下用户在写入队列之前已加入内存中的凭据存储，因此对登录立即可见，
+// COMMITTED方式下用户提交成功后才加入凭据存储，写入失败的用户名不会残留在存储中
+// QUEUED方式下，后台线程在队列中的用户达到batch_rows个、或最早的用户已等待interval时取出所有用户，
+// COMMITTED方式下，后台线程空闲时立即取出所有用户（组提交，避免工作线程额外等待interval），
+// 在一个事务中通过预处理的多行INSERT（每条sql_batch_rows行）写入，不足一条的剩余用户逐行写入，
+// 多行INSERT因用户名重复（如其他服务器实例注册了同名用户）失败时，该条中的用户改为逐行写入，只有冲突的用户写入失败，
+// 其他错误（如死锁、锁等待超时）使整个事务回滚，此时重试整个批次
+// 停止时写入队列中剩余的所有用户后才退出
+class registration_writer {
+	private:
+		// 队列中的用户，ticket指向等待提交的工作线程的状态，QUEUED方式下为nullptr
+		// 异步提交时不阻塞调用者，由后台线程在批次提交后调用done
+		struct ticket {
+			bool done = false;
+			bool ok = false;
+		};
+		struct pending {
+			std::string name;
+			std::string password;
+			ticket *waiter;
+			std::function<void(bool)> done;
+		};
+
+		// 事务因用户名重复以外的错误（如死锁）失败时，重试整个批次的次数
+		static const int max_batch_retries = 3;
+
+		connection_pool *_conn_pool = nullptr;
+		REGISTER_ACK _ack = REGISTER_ACK::COMMITTED;
+		std::size_t _batch_rows = 64; // QUEUED方式下触发写入的用户数
+		std::chrono::milliseconds _interval{10}; // QUEUED方式下用户在队列中的最长等待时间
+		std::vector<pending> _queue; // 等待写入的用户
+		std::chrono::steady_clock::time_point _oldest; // 队列中最早的用户的入队时间
+		std::mutex _mutex; // 保护队列和ticket的互斥锁
+		std::condition_variable _flush_cond; // 唤醒后台线程
+		std::condition_variable _done_cond; // 唤醒等待提交的工作线程
+		std::thread _flusher; // 后台线程
+		bool _stop = false; // 后台线程是否需要退出
+
+	private:
+		// 通过预处理语句插入batch中从first开始的rows个用户
+		static bool insert_users(MYSQL_STMT *stmt, const std::vector<pending> &batch, std::size_t first, std::size_t rows);
+		// 在一个事务中写入一批用户，用户名重复的用户在ok中标记为失败，事务因其他错误失败时返回false
+		static bool try_write_batch(MYSQL *mysql, MYSQL_STMT *single, MYSQL_STMT *multi,
+				const std::vector<pending> &batch, std::vector<bool> &ok);
+		// 写入一批用户，事务失败时重试整个批次，返回每个用户是否写入成功
+		std::vector<bool> write_batch(const std::vector<pending> &batch);
+		// 作为后台线程的回调函数，按用户数或等待时间批量写入
+		void flush();
+
+	public:
+		registration_writer() = default;
+		registration_writer(const registration_writer &rhs) = delete;
+		registration_writer& operator=(const registration_writer &rhs) = delete;
+		// 析构函数，需要等待后台线程写入所有用户后退出
+		~registration_writer() { stop(); }
+
+		// 初始化并启动后台线程，需在处理请求之前调用
+		void init(connection_pool *conn_pool, REGISTER_ACK ack = REGISTER_ACK::COMMITTED,
+				std::size_t batch_rows = 64, std::chrono::milliseconds interval = std::chrono::milliseconds(10));
+		// 获取持久化确认方式
+		REGISTER_ACK ack() const { return _ack; }
+		// 将用户写入队列，QUEUED方式下立即返回true，COMMITTED方式下返回用户是否已写入数据库，未初始化时返回false
+		bool submit(std::string_view name, std::string_view password);
+		// 异步地将用户写入队列，不阻塞调用者：COMMITTED方式下由后台线程在批次提交后以写入结果调用done，
+		// QUEUED方式下在返回前以true调用done，未初始化时返回false且不调用done
+		bool submit(std::string_view name, std::string_view password, std::function<void(bool)> done);
+		// 通知后台线程写入所有用户后退出并等待，需在销毁连接池之前调用
+		void stop();
+};
+
+#endif
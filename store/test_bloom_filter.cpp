@@ -0,0 +1,71 @@
+#include <iostream>
+#include <string>
+#include <iomanip>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cassert>
+
+#include "bloom_filter.h"
+#include "credential_store.h"
+
+std::string user_name(int i) { return "user" + std::to_string(i); }
+
+// 统计误判率：加入user_number个用户名后，判定另外user_number个一定不存在的用户名
+void test_false_positive(std::size_t expected, int user_number) {
+	bloom_filter filter(expected);
+	for (int i = 0; i < user_number; ++i) filter.add(user_name(i));
+	for (int i = 0; i < user_number; ++i) assert(filter.may_contain(user_name(i)));
+	int false_positive = 0;
+	for (int i = 0; i < user_number; ++i) false_positive += filter.may_contain(user_name(user_number + i));
+	std::cout << "expected " << std::setw(9) << expected << ", " << std::setw(9) << filter.size() << " users, "
+		<< std::setw(2) << filter.layer_count() << " layers, false positive rate " << std::fixed << std::setprecision(2)
+		<< 100.0 * false_positive / user_number << "%" << std::endl;
+	assert(filter.size() <= static_cast<std::size_t>(user_number));
+}
+
+// 多线程并发注册：每个线程加入不同的用户名，期间不断追加新层，结束后所有用户名都必须可能存在
+void test_concurrent() {
+	bloom_filter filter(1024);
+	const int thread_number = 4, user_number = 100000;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < thread_number; ++t)
+		threads.emplace_back([&filter, t]() {
+			for (int i = t; i < user_number; i += thread_number) {
+				filter.add(user_name(i));
+				assert(filter.may_contain(user_name(i)));
+			}
+		});
+	for (std::thread &thread : threads) thread.join();
+	for (int i = 0; i < user_number; ++i) assert(filter.may_contain(user_name(i)));
+	std::cout << "concurrent add: " << filter.size() << " users, " << filter.layer_count() << " layers" << std::endl;
+}
+
+// 判定一定不存在的用户名：布隆过滤器与凭据存储的耗时对比
+void bench_negative(int user_number) {
+	bloom_filter filter(user_number);
+	credential_store store(user_number);
+	for (int i = 0; i < user_number; ++i) { filter.add(user_name(i)); store.insert(user_name(i), "pw"); }
+	std::vector<std::string> names;
+	for (int i = 0; i < 1000000; ++i) names.push_back(user_name(user_number + i));
+
+	auto measure = [&names](const char *label, auto contains) {
+		auto start = std::chrono::steady_clock::now();
+		int found = 0;
+		for (const std::string &name : names) found += contains(name);
+		double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+		std::cout << std::left << std::setw(20) << label << std::fixed << std::setprecision(1)
+			<< elapsed / names.size() << " ns/lookup, " << found << " possible" << std::endl;
+	};
+	std::cout << "negative lookups among " << user_number << " users" << std::endl;
+	measure("bloom_filter", [&filter](const std::string &name) { return filter.may_contain(name); });
+	measure("credential_store", [&store](const std::string &name) { return store.contains(name); });
+}
+
+int main() {
+	test_false_positive(1000000, 1000000);
+	test_false_positive(1 << 16, 1000000);
+	test_concurrent();
+	bench_negative(1000000);
+	return 0;
+}
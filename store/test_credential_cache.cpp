@@ -0,0 +1,172 @@
+#include <iostream>
+#include <string>
+#include <iomanip>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cassert>
+
+#include "credential_cache.h"
+
+// 模拟数据库：用户名为user加上偶数的用户存在，每次检索耗时delay
+struct fake_database {
+	std::atomic<int> queries{0};
+	std::chrono::microseconds delay{0};
+	CREDENTIAL_STATUS operator()(std::string_view name, std::string &password) {
+		++queries;
+		if (delay.count() > 0) std::this_thread::sleep_for(delay);
+		if (name.substr(0, 4) != "user") return CREDENTIAL_STATUS::ERROR;
+		if (std::stoi(std::string(name.substr(4))) % 2) return CREDENTIAL_STATUS::NOT_FOUND;
+		password = "pw" + std::string(name.substr(4));
+		return CREDENTIAL_STATUS::FOUND;
+	}
+};
+
+// 存在、不存在的结果均被缓存，出错的结果不被缓存
+void test_basic() {
+	fake_database db;
+	credential_cache cache(std::ref(db), 1000);
+	std::string password;
+	assert(cache.get("user2", password) == CREDENTIAL_STATUS::FOUND && password == "pw2");
+	assert(cache.get("user2", password) == CREDENTIAL_STATUS::FOUND && db.queries == 1);
+	assert(cache.get("user3", password) == CREDENTIAL_STATUS::NOT_FOUND);
+	assert(cache.get("user3", password) == CREDENTIAL_STATUS::NOT_FOUND && db.queries == 2);
+	assert(cache.get("bad", password) == CREDENTIAL_STATUS::ERROR);
+	assert(cache.get("bad", password) == CREDENTIAL_STATUS::ERROR && db.queries == 4);
+	// 注册后覆盖负缓存
+	cache.put("user3", "new");
+	assert(cache.get("user3", password) == CREDENTIAL_STATUS::FOUND && password == "new" && db.queries == 4);
+	std::cout << "basic: ok" << std::endl;
+}
+
+// 有效期过后重新检索
+void test_ttl() {
+	fake_database db;
+	credential_cache cache(std::ref(db), 1000, std::chrono::seconds(1), std::chrono::seconds(0));
+	std::string password;
+	cache.get("user2", password);
+	cache.get("user3", password);
+	cache.get("user3", password);
+	assert(db.queries == 3);
+	std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+	cache.get("user2", password);
+	assert(db.queries == 4);
+	std::cout << "ttl: ok" << std::endl;
+}
+
+// 缓存的用户数不超过容量，且频繁访问的用户不被淘汰
+void test_eviction() {
+	fake_database db;
+	credential_cache cache(std::ref(db), 160);
+	std::string password;
+	for (int i = 0; i < 10000; ++i) {
+		cache.get("user0", password);
+		cache.get("user" + std::to_string(i + 2), password);
+	}
+	assert(cache.size() <= 160);
+	int before = db.queries;
+	cache.get("user0", password);
+	assert(db.queries == before);
+	std::cout << "eviction: " << cache.size() << " entries, " << db.queries << " queries" << std::endl;
+}
+
+// 容量不是分片数量的整数倍时，余数分配到各分片，缓存的用户数仍不超过容量
+void test_uneven_capacity() {
+	for (std::size_t capacity : {100, 5}) {
+		fake_database db;
+		credential_cache cache(std::ref(db), capacity);
+		std::string password;
+		for (int i = 0; i < 10000; ++i) cache.get("user" + std::to_string(i), password);
+		assert(cache.size() == capacity);
+	}
+	std::cout << "uneven capacity: ok" << std::endl;
+}
+
+// 同一用户名的并发未命中只检索一次，检索期间完成的注册不被检索结果覆盖
+void test_single_flight() {
+	fake_database db;
+	db.delay = std::chrono::milliseconds(100);
+	credential_cache cache(std::ref(db), 1000);
+	std::vector<std::thread> threads;
+	std::atomic<int> found{0};
+	for (int t = 0; t < 8; ++t)
+		threads.emplace_back([&cache, &found]() {
+			std::string password;
+			found += cache.get("user4", password) == CREDENTIAL_STATUS::FOUND && password == "pw4";
+		});
+	for (std::thread &thread : threads) thread.join();
+	assert(db.queries == 1 && found == 8);
+	std::cout << "single flight: " << db.queries << " query, " << cache.coalesced_count() << " coalesced" << std::endl;
+
+	std::thread lookup([&cache]() { std::string password; cache.get("user5", password); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	cache.put("user5", "registered");
+	lookup.join();
+	std::string password;
+	assert(cache.get("user5", password) == CREDENTIAL_STATUS::FOUND && password == "registered");
+	std::cout << "stale flight: ok" << std::endl;
+}
+
+// 调用者自行检索：期间同一用户名的get等待其结果，检索期间完成的注册同样不被覆盖
+void test_external_fetch() {
+	fake_database db;
+	credential_cache cache(std::ref(db), 1000);
+	CREDENTIAL_STATUS status;
+	std::string password;
+	assert(!cache.lookup("user6", status, password));
+	assert(cache.begin_fetch("user6"));
+	assert(!cache.begin_fetch("user6"));
+	std::atomic<bool> waited = false;
+	std::thread waiter([&cache, &waited]() {
+		std::string password;
+		waited = cache.get("user6", password) == CREDENTIAL_STATUS::FOUND && password == "pw6";
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	cache.end_fetch("user6", CREDENTIAL_STATUS::FOUND, "pw6");
+	waiter.join();
+	assert(waited && db.queries == 0);
+	assert(cache.lookup("user6", status, password) && status == CREDENTIAL_STATUS::FOUND && password == "pw6");
+
+	assert(cache.begin_fetch("user7"));
+	cache.put("user7", "registered");
+	cache.end_fetch("user7", CREDENTIAL_STATUS::NOT_FOUND, "");
+	assert(cache.lookup("user7", status, password) && status == CREDENTIAL_STATUS::FOUND && password == "registered");
+	std::cout << "external fetch: ok" << std::endl;
+}
+
+// 命中时的查找耗时
+void bench_hit(int thread_number) {
+	fake_database db;
+	// 容量留有余量，避免分片不均匀导致淘汰
+	credential_cache cache(std::ref(db), 200000);
+	std::string password;
+	for (int i = 0; i < 100000; ++i) cache.get("user" + std::to_string(i), password);
+	std::vector<std::string> names;
+	for (int i = 0; i < 100000; ++i) names.push_back("user" + std::to_string(i * 7919 % 100000));
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	for (int t = 0; t < thread_number; ++t)
+		threads.emplace_back([&cache, &names]() {
+			std::string password;
+			for (int round = 0; round < 10; ++round)
+				for (const std::string &name : names) cache.get(name, password);
+		});
+	for (std::thread &thread : threads) thread.join();
+	double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	std::cout << std::left << std::setw(10) << thread_number << std::fixed << std::setprecision(1)
+		<< elapsed / (10 * names.size()) << " ns/lookup per thread" << std::endl;
+	assert(db.queries == 100000);
+}
+
+int main() {
+	test_basic();
+	test_ttl();
+	test_eviction();
+	test_uneven_capacity();
+	test_single_flight();
+	test_external_fetch();
+	std::cout << std::left << std::setw(10) << "threads" << std::endl;
+	for (int thread_number : {1, 2, 4, 8}) bench_hit(thread_number);
+	return 0;
+}
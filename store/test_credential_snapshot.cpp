@@ -0,0 +1,88 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cassert>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "credential_snapshot.h"
+#include "credential_store.h"
+
+std::string user_name(int i) { return "user" + std::to_string(i); }
+std::string user_password(int i) { return "pw" + std::to_string(i * 7); }
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// 写入user_number个用户的快照，再合并新增的用户，对比映射快照与逐个插入凭据存储的启动耗时
+void test_snapshot(int user_number) {
+	const std::string path = "./test_users.snapshot";
+	std::vector<std::pair<std::string, std::string>> rows;
+	for (int i = 0; i < user_number; ++i) rows.emplace_back(user_name(i), user_password(i));
+	auto start = std::chrono::steady_clock::now();
+	assert(credential_snapshot::write(path, nullptr, rows, user_number));
+	std::cout << user_number << " users: write " << seconds_since(start) << " s";
+
+	// 映射快照即为启动时的全部工作，之后的查找按需读入所在的页
+	start = std::chrono::steady_clock::now();
+	credential_snapshot snapshot;
+	assert(snapshot.open(path));
+	std::cout << ", open " << seconds_since(start) << " s";
+
+	start = std::chrono::steady_clock::now();
+	credential_store store(user_number);
+	for (const auto &row : rows) store.insert(row.first, row.second);
+	std::cout << ", insert into credential_store " << seconds_since(start) << " s" << std::endl;
+
+	assert(snapshot.size() == static_cast<std::size_t>(user_number) && snapshot.max_id() == static_cast<std::uint64_t>(user_number));
+	for (int i = 0; i < user_number; i += 97) {
+		assert(snapshot.verify(user_name(i), user_password(i)));
+		assert(!snapshot.verify(user_name(i), "wrong"));
+		assert(!snapshot.contains(user_name(user_number + i)));
+	}
+
+	// 合并新增的用户，其中一个与快照重复、一个彼此重复，均只保留第一个
+	std::vector<std::pair<std::string, std::string>> delta = {
+		{user_name(user_number), "new"}, {user_name(0), "duplicate"}, {user_name(user_number), "duplicate"}};
+	assert(credential_snapshot::write(path, &snapshot, delta, user_number + 3));
+	credential_snapshot merged;
+	assert(merged.open(path));
+	assert(merged.size() == static_cast<std::size_t>(user_number) + 1 && merged.max_id() == static_cast<std::uint64_t>(user_number) + 3);
+	assert(merged.verify(user_name(0), user_password(0)) && merged.verify(user_name(user_number), "new"));
+	// 旧的映射不受重命名替换的影响
+	assert(snapshot.verify(user_name(1), user_password(1)) && !snapshot.contains(user_name(user_number)));
+
+	// 损坏的凭据记录（长度超出记录区）和没有空槽位的哈希索引不会导致越界访问或死循环
+	{
+		std::vector<std::pair<std::string, std::string>> small = {{user_name(0), user_password(0)}};
+		assert(credential_snapshot::write(path, nullptr, small, 1));
+		const std::uint32_t huge = 0xffffffff;
+		int fd = open(path.c_str(), O_RDWR);
+		assert(pwrite(fd, &huge, sizeof(huge), 64 + 16 * 8) == sizeof(huge));
+		credential_snapshot corrupt;
+		assert(corrupt.open(path) && !corrupt.contains(user_name(0)) && !corrupt.contains(user_name(1)));
+		std::size_t visited = 0;
+		corrupt.for_each([&visited](std::string_view, std::string_view) { ++visited; });
+		assert(visited == 0);
+		const std::uint64_t full = 0xffff000000000001ULL;
+		for (int i = 0; i < 16; ++i) assert(pwrite(fd, &full, sizeof(full), 64 + i * 8) == sizeof(full));
+		close(fd);
+		credential_snapshot no_empty_slot;
+		assert(no_empty_slot.open(path) && !no_empty_slot.contains(user_name(1)));
+	}
+
+	// 截断的文件不能被映射
+	assert(truncate(path.c_str(), 100) == 0);
+	credential_snapshot truncated;
+	assert(!truncated.open(path));
+	unlink(path.c_str());
+}
+
+// 以参数10m运行时额外测试一千万用户
+int main(int argc, char *argv[]) {
+	test_snapshot(1000000);
+	if (argc > 1 && std::string(argv[1]) == "10m") test_snapshot(10000000);
+	return 0;
+}
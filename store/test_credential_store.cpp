@@ -0,0 +1,106 @@
+#include <iostream>
+#include <string>
+#include <iomanip>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <cassert>
+
+#include "credential_store.h"
+
+std::string user_name(int i) { return "user" + std::to_string(i); }
+std::string user_password(int i) { return "pw" + std::to_string(i * 7); }
+
+// 多线程登录校验的基准测试：每个线程查找lookup_number次，一半为已存在的用户，一半为不存在的用户
+template <typename Verify>
+void bench(int thread_number, int user_number, int lookup_number, Verify verify) {
+	// 预先生成用户名，避免在计时区间内构造字符串
+	std::vector<std::string> names, passwords;
+	for (int i = 0; i < lookup_number; ++i) {
+		int user = static_cast<int>((i * 2654435761u) % static_cast<unsigned>(user_number));
+		names.push_back(i % 2 ? user_name(user) : user_name(user_number + user));
+		passwords.push_back(user_password(user));
+	}
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	for (int t = 0; t < thread_number; ++t) {
+		threads.emplace_back([&names, &passwords, lookup_number, &verify]() {
+			int found = 0;
+			for (int i = 0; i < lookup_number; ++i) found += verify(names[i], passwords[i]);
+			assert(found == lookup_number / 2);
+			(void)found;
+		});
+	}
+	for (std::thread &thread : threads) thread.join();
+	double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	std::cout << std::left << std::setw(10) << thread_number << std::fixed << std::setprecision(1)
+		<< std::setw(12) << elapsed / lookup_number << " ns/lookup per thread, "
+		<< thread_number * lookup_number / elapsed * 1000 << " M lookup/s" << std::endl;
+}
+
+void bench_store(int user_number) {
+	auto start = std::chrono::steady_clock::now();
+	credential_store store(user_number);
+	for (int i = 0; i < user_number; ++i) store.insert(user_name(i), user_password(i));
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "credential_store: " << store.size() << " users loaded in " << elapsed << " s" << std::endl;
+	assert(store.size() == static_cast<std::size_t>(user_number));
+	assert(!store.insert(user_name(0), "other") && store.verify(user_name(0), user_password(0)));
+
+	std::cout << std::left << std::setw(10) << "threads" << std::endl;
+	for (int thread_number : {1, 2, 4, 8})
+		bench(thread_number, user_number, 1000000, [&store](const std::string &name, const std::string &password) {
+			return store.verify(name, password);
+		});
+}
+
+// 作为对照，原先的实现：std::map，登录不加锁（存在数据竞争），注册时加全局互斥锁，这里在查找时也加锁以保证正确
+void bench_map(int user_number) {
+	std::map<std::string, std::string> users;
+	std::mutex mtx;
+	for (int i = 0; i < user_number; ++i) users.emplace(user_name(i), user_password(i));
+	std::cout << "std::map + mutex: " << users.size() << " users" << std::endl;
+	for (int thread_number : {1, 2, 4, 8})
+		bench(thread_number, user_number, 1000000, [&users, &mtx](const std::string &name, const std::string &password) {
+			std::lock_guard<std::mutex> lock(mtx);
+			auto it = users.find(name);
+			return it != users.end() && it->second == password;
+		});
+}
+
+// 并发注册与登录：写线程不断插入新用户（触发扩容），读线程同时校验已插入的用户
+void test_concurrent() {
+	credential_store store;
+	const int user_number = 200000;
+	std::atomic<int> inserted{0};
+	std::thread writer([&store, &inserted]() {
+		for (int i = 0; i < user_number; ++i) {
+			store.insert(user_name(i), user_password(i));
+			inserted.store(i + 1, std::memory_order_release);
+		}
+	});
+	std::vector<std::thread> readers;
+	std::atomic<int> failed{0};
+	for (int t = 0; t < 4; ++t) {
+		readers.emplace_back([&store, &inserted, &failed]() {
+			for (int done; (done = inserted.load(std::memory_order_acquire)) < user_number; )
+				for (int i = done - 1; i >= 0 && i > done - 64; --i)
+					if (!store.verify(user_name(i), user_password(i))) ++failed;
+		});
+	}
+	writer.join();
+	for (std::thread &reader : readers) reader.join();
+	std::cout << "concurrent insert/verify: " << store.size() << " users, " << failed << " failed" << std::endl;
+	assert(failed == 0 && store.size() == static_cast<std::size_t>(user_number));
+}
+
+// 以参数10m运行时额外测试一千万用户（约需600MB内存）
+int main(int argc, char *argv[]) {
+	test_concurrent();
+	bench_store(1000000);
+	bench_map(1000000);
+	if (argc > 1 && std::string(argv[1]) == "10m") bench_store(10000000);
+	return 0;
+}
@@ -0,0 +1,46 @@
+#include <iostream>
+#include <string>
+#include <iomanip>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+#include "registration_writer.h"
+#include "../pool/connection_pool.h"
+
+// 多线程并发注册的基准测试，需要可用的数据库，测试用户的用户名以prefix开头
+void bench(connection_pool *conn_pool, REGISTER_ACK ack, const std::string &prefix, int thread_number, int user_number) {
+	registration_writer writer;
+	writer.init(conn_pool, ack);
+	std::atomic<int> failed{0};
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	for (int t = 0; t < thread_number; ++t) {
+		threads.emplace_back([&writer, &failed, &prefix, t, user_number]() {
+			for (int i = 0; i < user_number; ++i)
+				if (!writer.submit(prefix + std::to_string(t) + "_" + std::to_string(i), "123456")) ++failed;
+		});
+	}
+	for (std::thread &thread : threads) thread.join();
+	double submitted = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+	// 停止时写入队列中剩余的用户
+	writer.stop();
+	double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+	std::cout << (ack == REGISTER_ACK::QUEUED ? "queued    " : "committed ") << std::setw(10) << thread_number
+		<< std::fixed << std::setprecision(1) << std::setw(12) << submitted / user_number << " us/register per thread, "
+		<< thread_number * user_number / elapsed * 1e6 << " register/s, " << failed << " failed" << std::endl;
+}
+
+int main() {
+	auto conn_pool = connection_pool::get_instance();
+	conn_pool->init("localhost", "root", 3306, "$Li&&990503", "web_server", 8);
+	std::string prefix = "bench" + std::to_string(std::chrono::system_clock::now().time_since_epoch().count() % 1000000) + "_";
+	std::cout << std::left << std::setw(10) << "ack" << std::setw(10) << "threads" << std::endl;
+	for (int thread_number : {1, 4, 8}) {
+		bench(conn_pool, REGISTER_ACK::COMMITTED, prefix + "c" + std::to_string(thread_number) + "_", thread_number, 1000);
+		bench(conn_pool, REGISTER_ACK::QUEUED, prefix + "q" + std::to_string(thread_number) + "_", thread_number, 1000);
+	}
+	// 测试用户需手动删除：DELETE FROM user WHERE username LIKE 'bench%';
+	return 0;
+}
@@ -195,8 +195,9 @@ void timer_heap<Timer>::del_timer(Timer *timer) {
 	// 删除尾元素（原先堆中任意位置的元素）
 	delete _heap.back();
 	_heap.pop_back();
-	// 如果上滤不成功就尝试下滤
-	if (!shift_up(hole_idx)) shift_down(hole_idx);
+	// 若删除的就是尾元素，则hole_idx已越界，无需调整
+	// 否则如果上滤不成功就尝试下滤
+	if (hole_idx < _heap.size() && !shift_up(hole_idx)) shift_down(hole_idx);
 #ifndef NDEBUG
 	for (std::size_t i = 0; i < _heap.size(); ++i) {
 		std::cout << get_format_time(_heap[i]->expire) << " id: " << _heap[i]->id << std::endl;